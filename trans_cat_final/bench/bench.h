@@ -0,0 +1,33 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <string_view>
+
+/*
+ * Замеры для сравнения реализаций на одних и тех же данных
+ */
+
+namespace bench {
+
+// Вызывает func() repeat раз и печатает лучшее время и скорость: items
+// единиц unit за вызов. func возвращает размер результата — он печатается
+// для сверки и не даёт компилятору выбросить работу
+template <typename Func>
+void Run(std::string_view name, size_t items, std::string_view unit, int repeat, Func func) {
+    using Clock = std::chrono::steady_clock;
+    double best = 0;
+    size_t size = 0;
+    for (int i = 0; i < repeat; ++i) {
+        const auto start = Clock::now();
+        size = func();
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        best = i == 0 ? seconds : std::min(best, seconds);
+    }
+    std::printf("  %-32.*s %9.2f ms %9.1f M%.*s/s  (%zu)\n", static_cast<int>(name.size()), name.data(),
+                best * 1e3, items / best / 1e6, static_cast<int>(unit.size()), unit.data(), size);
+}
+
+}  // namespace bench
@@ -0,0 +1,21 @@
+TEMPLATE = app
+CONFIG += console c++17 release
+CONFIG -= app_bundle debug
+CONFIG -= qt
+
+# Замеры имеют смысл только с оптимизацией. Для ветки AVX2 экранирования:
+# qmake "QMAKE_CXXFLAGS += -mavx2"
+TARGET = trans_cat_bench
+INCLUDEPATH += ..
+
+SOURCES += \
+        ../escape.cpp \
+        ../json.cpp \
+        ../svg.cpp \
+        escape_bench.cpp \
+        main.cpp \
+        numbers_bench.cpp \
+        svg_bench.cpp
+
+HEADERS += \
+    bench.h
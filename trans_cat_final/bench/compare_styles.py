@@ -0,0 +1,43 @@
+#!/usr/bin/env python3
+# Сравнивает итоговые атрибуты элементов двух карт: классы CSS из блока
+# <style> подставляются обратно в элементы.
+# Запуск: compare_styles.py inline.json classes.json — ответы на запрос Map
+import html
+import json
+import re
+import sys
+import xml.etree.ElementTree as ET
+
+SVG = '{http://www.w3.org/2000/svg}'
+
+
+def load_elements(path):
+    text = json.load(open(path))[0]['map']
+    # Содержимое <text> выводится без экранирования XML
+    text = re.sub(r'(<text[^>]*>)(.*?)(</text>)',
+                  lambda m: m.group(1) + html.escape(m.group(2)) + m.group(3), text)
+    root = ET.fromstring(text)
+    classes = {}
+    for style in root.iter(SVG + 'style'):
+        for name, body in re.findall(r'\.(\w+)\{([^}]*)\}', style.text):
+            declarations = {}
+            for declaration in body.split(';'):
+                key, value = declaration.split(':', 1)
+                declarations[key] = value[:-2] if value.endswith('px') else value
+            classes[name] = declarations
+    elements = []
+    for element in root:
+        if element.tag == SVG + 'style':
+            continue
+        attributes = dict(element.attrib)
+        if 'class' in attributes:
+            attributes.update(classes[attributes.pop('class')])
+        elements.append((element.tag, attributes, element.text))
+    return elements
+
+
+expected, actual = load_elements(sys.argv[1]), load_elements(sys.argv[2])
+if expected != actual:
+    print(f'DIFFERENT: {len(expected)} and {len(actual)} elements')
+    sys.exit(1)
+print(f'equal: {len(expected)} elements')
@@ -0,0 +1,90 @@
+#include "bench.h"
+
+#include "../escape.h"
+
+#include <cstring>
+#include <sstream>
+#include <string>
+
+namespace {
+
+// Текст карты того же вида, что уходит в ответ Map: много кавычек и переводов строк
+std::string MakeSvgText(size_t size) {
+    std::string text;
+    while (text.size() < size) {
+        text += "  <polyline points=\"123.456,789.012 345.678,901.234\" fill=\"none\" stroke=\"green\"/>\n"
+                "  <text x=\"1\" y=\"2\">S1</text>\n";
+    }
+    return text;
+}
+
+// Прежняя реализация: посимвольно в поток
+size_t EscapePerChar(const std::string& text) {
+    std::ostringstream output;
+    for (const char c : text) {
+        switch (c) {
+        case '"':
+            output << "\\\"";
+            break;
+        case '\\':
+            output << "\\\\";
+            break;
+        case '\n':
+            output << "\\n";
+            break;
+        case '\r':
+            output << "\\r";
+            break;
+        case '\t':
+            output << "\\t";
+            break;
+        default:
+            output << c;
+        }
+    }
+    return output.str().size();
+}
+
+}  // namespace
+
+void BenchEscape() {
+    const std::string svg = MakeSvgText(32 << 20);
+    std::string clean = svg;
+    for (char& c : clean) {
+        if (c == '"' || c == '\n') {
+            c = '\'';
+        }
+    }
+#if defined(__AVX2__)
+    std::printf("escape: %zu MB of SVG text, AVX2\n", svg.size() >> 20);
+#elif defined(__SSE2__)
+    std::printf("escape: %zu MB of SVG text, SSE2\n", svg.size() >> 20);
+#else
+    std::printf("escape: %zu MB of SVG text, no SIMD\n", svg.size() >> 20);
+#endif
+    bench::Run("new string + memcpy", svg.size(), "B", 3, [&] {
+        std::string output(svg.size(), '\0');
+        std::memcpy(output.data(), svg.data(), svg.size());
+        return output.size();
+    });
+    bench::Run("per char to ostream", svg.size(), "B", 3, [&] {
+        return EscapePerChar(svg);
+    });
+    bench::Run("Escaper::Write to ostream", svg.size(), "B", 3, [&] {
+        std::ostringstream output;
+        escape::Json().Write(output, svg);
+        return output.str().size();
+    });
+    bench::Run("Escaper::Append to string", svg.size(), "B", 3, [&] {
+        std::string output;
+        output.reserve(svg.size() + svg.size() / 8);
+        escape::Json().Append(output, svg);
+        return output.size();
+    });
+    bench::Run("Escaper::Append, no specials", clean.size(), "B", 3, [&] {
+        std::string output;
+        output.reserve(clean.size());
+        escape::Json().Append(output, clean);
+        return output.size();
+    });
+}
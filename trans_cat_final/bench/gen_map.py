@@ -0,0 +1,36 @@
+#!/usr/bin/env python3
+# Большой город с одним запросом Map: для замеров отрисовки карты.
+# Запуск: gen_map.py STOPS BUSES > map.json
+import json
+import random
+import sys
+
+stop_count, bus_count = map(int, sys.argv[1:3])
+random.seed(7)
+
+# Каждая седьмая остановка — с символами, которые нужно экранировать
+stops = [f'Stop {i} & <Str"eet>' if i % 7 == 0 else f'S{i}' for i in range(stop_count)]
+base = [{'type': 'Stop', 'name': name,
+         'latitude': 55.5 + random.random() * 0.3,
+         'longitude': 37.4 + random.random() * 0.4,
+         'road_distances': {}} for name in stops]
+for i in range(bus_count):
+    route = random.sample(stops, random.randint(5, 25))
+    roundtrip = random.random() < 0.5
+    if roundtrip:
+        route.append(route[0])
+    base.append({'type': 'Bus', 'name': f'B{i}', 'stops': route, 'is_roundtrip': roundtrip})
+
+document = {
+    'base_requests': base,
+    'render_settings': {
+        'width': 1200.0, 'height': 1200.0, 'padding': 50.0, 'line_width': 14.0, 'stop_radius': 5.0,
+        'bus_label_font_size': 20, 'bus_label_offset': [7.0, 15.0],
+        'stop_label_font_size': 20, 'stop_label_offset': [7.0, -3.0],
+        'underlayer_color': [255, 255, 255, 0.85], 'underlayer_width': 3.0,
+        'color_palette': ['green', [255, 160, 0], 'red', [1, 2, 3, 0.5]],
+    },
+    'routing_settings': {'bus_wait_time': 6, 'bus_velocity': 40},
+    'stat_requests': [{'id': 1, 'type': 'Map'}],
+}
+print(json.dumps(document))
@@ -0,0 +1,48 @@
+#include <cstdio>
+#include <string_view>
+
+void BenchCss();
+void BenchEscape();
+void BenchNumbers();
+void BenchSvg();
+
+namespace {
+
+struct Benchmark {
+    std::string_view name;
+    void (*run)();
+};
+
+constexpr Benchmark BENCHMARKS[] = {
+    {"numbers", BenchNumbers},
+    {"escape", BenchEscape},
+    {"svg", BenchSvg},
+    {"css", BenchCss},
+};
+
+}  // namespace
+
+// Запуск: bench [название...]; без аргументов выполняются все замеры
+int main(int argc, char* argv[]) {
+    if (argc == 1) {
+        for (const Benchmark& benchmark : BENCHMARKS) {
+            benchmark.run();
+        }
+        return 0;
+    }
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view name = argv[i];
+        bool found = false;
+        for (const Benchmark& benchmark : BENCHMARKS) {
+            if (benchmark.name == name) {
+                benchmark.run();
+                found = true;
+            }
+        }
+        if (!found) {
+            std::fprintf(stderr, "Unknown benchmark: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    return 0;
+}
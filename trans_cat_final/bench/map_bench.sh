@@ -0,0 +1,37 @@
+#!/bin/bash
+# Время и размер ответа Map на большом городе при разных настройках вывода
+# карты. Карта с классами CSS сверяется с картой с атрибутами.
+# Запуск: map_bench.sh путь/к/trans_cat_final [STOPS BUSES]
+set -euo pipefail
+
+if [ $# -lt 1 ]; then
+    echo "Usage: $0 path/to/trans_cat_final [stops buses]" >&2
+    exit 2
+fi
+binary=$1
+stops=${2:-50000}
+buses=${3:-10000}
+here=$(dirname "$0")
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+python3 "$here/gen_map.py" "$stops" "$buses" > "$work/map.json"
+echo "map: $stops stops, $buses buses"
+
+run() {
+    local name=$1
+    shift
+    local start end
+    start=$(date +%s%N)
+    "$binary" "$@" < "$work/map.json" > "$work/$name.json"
+    end=$(date +%s%N)
+    printf "  %-24s %8d ms %12d bytes\n" "$name" $(((end - start) / 1000000)) "$(stat -c %s "$work/$name.json")"
+}
+
+run inline
+run css-classes --css-classes
+run fixed-2 --map-fixed=2
+run css-classes-fixed-2 --css-classes --map-fixed=2
+run shortest --map-shortest
+run svgz-6 --map-svgz=6
+python3 "$here/compare_styles.py" "$work/inline.json" "$work/css-classes.json"
@@ -0,0 +1,93 @@
+#include "bench.h"
+
+#include "../json.h"
+
+#include <charconv>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Координаты и расстояния того же масштаба, что в ответах и входных данных
+std::vector<double> MakeNumbers(size_t count) {
+    std::mt19937_64 random(1);
+    std::uniform_real_distribution<double> distribution(0, 5000);
+    std::vector<double> numbers(count);
+    for (double& number : numbers) {
+        number = distribution(random);
+    }
+    return numbers;
+}
+
+// SHORTEST обязан читаться обратно в то же число
+void CheckShortestRoundTrip(const std::vector<double>& numbers) {
+    std::string text;
+    for (const double number : numbers) {
+        text.clear();
+        json::AppendNumber(text, number, json::DoubleFormat::SHORTEST);
+        double parsed = 0;
+        std::from_chars(text.data(), text.data() + text.size(), parsed);
+        if (parsed != number) {
+            std::fprintf(stderr, "SHORTEST round trip failed for %s\n", text.c_str());
+            std::exit(1);
+        }
+    }
+}
+
+}  // namespace
+
+void BenchNumbers() {
+    const size_t count = 1'000'000;
+    const auto numbers = MakeNumbers(count);
+    CheckShortestRoundTrip(numbers);
+
+    std::printf("numbers: formatting %zu doubles\n", count);
+    bench::Run("ostream <<", count, "num", 3, [&] {
+        std::ostringstream output;
+        for (const double number : numbers) {
+            output << number << ',';
+        }
+        return output.str().size();
+    });
+    bench::Run("AppendNumber STREAM", count, "num", 3, [&] {
+        std::string output;
+        for (const double number : numbers) {
+            json::AppendNumber(output, number);
+            output += ',';
+        }
+        return output.size();
+    });
+    bench::Run("AppendNumber SHORTEST", count, "num", 3, [&] {
+        std::string output;
+        for (const double number : numbers) {
+            json::AppendNumber(output, number, json::DoubleFormat::SHORTEST);
+            output += ',';
+        }
+        return output.size();
+    });
+
+    std::printf("numbers: parsing an array of %zu doubles\n", count);
+    std::string text = "[";
+    for (const double number : numbers) {
+        json::AppendNumber(text, number, json::DoubleFormat::SHORTEST);
+        text += ',';
+    }
+    text.back() = ']';
+    bench::Run("istream >> double", count, "num", 3, [&] {
+        std::istringstream input(text);
+        size_t parsed = 0;
+        char separator;
+        input >> separator;
+        for (double number; input >> number >> separator;) {
+            ++parsed;
+        }
+        return parsed;
+    });
+    bench::Run("json::Load", count, "num", 3, [&] {
+        std::istringstream input(text);
+        return json::Load(input).GetRoot().AsArray().size();
+    });
+}
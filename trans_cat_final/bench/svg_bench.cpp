@@ -0,0 +1,158 @@
+#include "bench.h"
+
+#include "../svg.h"
+
+#include <cstdlib>
+#include <ostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Синтетическая карта: линии маршрутов, подписи и кружки остановок
+struct Scene {
+    std::vector<std::vector<svg::Point>> lines;
+    std::vector<svg::Point> labels;
+    std::vector<svg::Point> stops;
+};
+
+Scene MakeScene(size_t line_count, size_t points_per_line, size_t stop_count) {
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> coordinate(0, 1200);
+    Scene scene;
+    scene.lines.resize(line_count);
+    for (auto& line : scene.lines) {
+        for (size_t i = 0; i < points_per_line; ++i) {
+            line.push_back({coordinate(random), coordinate(random)});
+        }
+    }
+    for (size_t i = 0; i < stop_count; ++i) {
+        scene.labels.push_back({coordinate(random), coordinate(random)});
+        scene.stops.push_back({coordinate(random), coordinate(random)});
+    }
+    return scene;
+}
+
+svg::Document MakeDocument(const Scene& scene) {
+    svg::Document document;
+    for (const auto& line : scene.lines) {
+        svg::Polyline polyline;
+        polyline.SetStrokeColor("green").SetStrokeWidth(14).SetFillColor("none")
+            .SetStrokeLineCap(svg::StrokeLineCap::ROUND).SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+        for (const svg::Point point : line) {
+            polyline.AddPoint(point);
+        }
+        document.Add(std::move(polyline));
+    }
+    for (size_t i = 0; i < scene.labels.size(); ++i) {
+        svg::Text text;
+        text.SetPosition(scene.labels[i]).SetOffset({7, -3}).SetFontSize(20).SetFontFamily("Verdana")
+            .SetData("S" + std::to_string(i)).SetFillColor("rgba(255,255,255,0.85)")
+            .SetStrokeColor("rgba(255,255,255,0.85)").SetStrokeWidth(3)
+            .SetStrokeLineCap(svg::StrokeLineCap::ROUND).SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+        document.Add(std::move(text));
+        svg::Circle circle;
+        circle.SetCenter(scene.stops[i]).SetRadius(5).SetFillColor("white");
+        document.Add(std::move(circle));
+    }
+    return document;
+}
+
+// Вывод до OutputBuffer: числа через operator<<, std::endl после каждого объекта
+void RenderBefore(const Scene& scene, std::ostream& out) {
+    out << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>" << std::endl;
+    out << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">" << std::endl;
+    for (const auto& line : scene.lines) {
+        out << "<polyline points=\"";
+        bool first = true;
+        for (const svg::Point point : line) {
+            if (!first) {
+                out << ' ';
+            }
+            first = false;
+            out << point.x << ',' << point.y;
+        }
+        out << "\" fill=\"none\" stroke=\"green\" stroke-width=\"" << 14.0
+            << "\" stroke-linecap=\"round\" stroke-linejoin=\"round\"/>" << std::endl;
+    }
+    for (size_t i = 0; i < scene.labels.size(); ++i) {
+        out << "<text fill=\"rgba(255,255,255,0.85)\" stroke=\"rgba(255,255,255,0.85)\" stroke-width=\"" << 3.0
+            << "\" stroke-linecap=\"round\" stroke-linejoin=\"round\" x=\"" << scene.labels[i].x << "\" y=\""
+            << scene.labels[i].y << "\" dx=\"" << 7.0 << "\" dy=\"" << -3.0 << "\" font-size=\"" << 20
+            << "\" font-family=\"Verdana\">S" << i << "</text>" << std::endl;
+        out << "<circle cx=\"" << scene.stops[i].x << "\" cy=\"" << scene.stops[i].y << "\" r=\"" << 5.0
+            << "\" fill=\"white\"/>" << std::endl;
+    }
+    out << "</svg>";
+}
+
+}  // namespace
+
+void BenchSvg() {
+    const Scene scene = MakeScene(20'000, 20, 100'000);
+    const svg::Document document = MakeDocument(scene);
+    std::string expected;
+    document.Render(expected);
+    {
+        std::ostringstream before;
+        RenderBefore(scene, before);
+        if (before.str() != expected) {
+            std::fprintf(stderr, "svg: the reference writer differs from Document::Render\n");
+            std::exit(1);
+        }
+    }
+    const size_t bytes = expected.size();
+
+    std::printf("svg: %zu polylines, %zu labels, %zu circles, %.1f MB per render\n", scene.lines.size(),
+                scene.labels.size(), scene.stops.size(), bytes / 1e6);
+    bench::Run("before: ostream <<, endl", bytes, "B", 3, [&] {
+        std::ostringstream output;
+        RenderBefore(scene, output);
+        return output.str().size();
+    });
+    bench::Run("Document::Render to ostream", bytes, "B", 3, [&] {
+        std::ostringstream output;
+        document.Render(output);
+        return output.str().size();
+    });
+    bench::Run("Document::Render to string", bytes, "B", 3, [&] {
+        std::string output;
+        document.Render(output);
+        return output.size();
+    });
+    bench::Run("to string, FIXED 2", bytes, "B", 3, [&] {
+        std::string output;
+        document.Render(output, {svg::NumberStyle::FIXED, 2});
+        return output.size();
+    });
+    bench::Run("to string, SHORTEST", bytes, "B", 3, [&] {
+        std::string output;
+        document.Render(output, {svg::NumberStyle::SHORTEST});
+        return output.size();
+    });
+}
+
+void BenchCss() {
+    const Scene scene = MakeScene(20'000, 20, 100'000);
+    const svg::Document document = MakeDocument(scene);
+    std::string inline_styles;
+    document.Render(inline_styles);
+    std::string classes;
+    document.Render(classes, {}, svg::StyleMode::CLASSES);
+
+    const size_t objects = scene.lines.size() + scene.labels.size() + scene.stops.size();
+    std::printf("css: the svg scene, attributes inline %.1f MB, CSS classes %.1f MB\n", inline_styles.size() / 1e6,
+                classes.size() / 1e6);
+    bench::Run("StyleMode::INLINE", objects, "obj", 3, [&] {
+        std::string output;
+        document.Render(output);
+        return output.size();
+    });
+    bench::Run("StyleMode::CLASSES", objects, "obj", 3, [&] {
+        std::string output;
+        document.Render(output, {}, svg::StyleMode::CLASSES);
+        return output.size();
+    });
+}
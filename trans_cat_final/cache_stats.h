@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+
+namespace cache {
+
+struct CacheStats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+    // Значения, которые не были приняты: не поместились в бюджет
+    // или оказались реже всех, кого пришлось бы вытеснить
+    size_t rejections = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+};
+
+}  // namespace cache
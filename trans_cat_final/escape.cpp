@@ -0,0 +1,136 @@
+#include "escape.h"
+
+#include <stdexcept>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace escape {
+
+using namespace std::literals;
+
+namespace {
+
+constexpr std::string_view CONTROL_ESCAPES[] = {
+    "\\u0000"sv, "\\u0001"sv, "\\u0002"sv, "\\u0003"sv, "\\u0004"sv, "\\u0005"sv, "\\u0006"sv, "\\u0007"sv,
+    "\\u0008"sv, "\\u0009"sv, "\\u000a"sv, "\\u000b"sv, "\\u000c"sv, "\\u000d"sv, "\\u000e"sv, "\\u000f"sv,
+    "\\u0010"sv, "\\u0011"sv, "\\u0012"sv, "\\u0013"sv, "\\u0014"sv, "\\u0015"sv, "\\u0016"sv, "\\u0017"sv,
+    "\\u0018"sv, "\\u0019"sv, "\\u001a"sv, "\\u001b"sv, "\\u001c"sv, "\\u001d"sv, "\\u001e"sv, "\\u001f"sv,
+};
+constexpr char LAST_CONTROL = 0x1F;
+
+}  // namespace
+
+Escaper::Escaper(std::initializer_list<std::pair<char, std::string_view>> replacements, bool escape_controls)
+    : escape_controls_(escape_controls) {
+    if (replacements.size() == 0 || replacements.size() > MAX_SPECIALS) {
+        throw std::invalid_argument("Escaper supports 1.."s + std::to_string(MAX_SPECIALS)
+                                    + " special characters"s);
+    }
+    specials_.fill(replacements.begin()->first);
+    size_t i = 0;
+    for (const auto& [c, replacement] : replacements) {
+        const auto index = static_cast<unsigned char>(c);
+        replacements_[index] = replacement;
+        is_special_[index] = true;
+        specials_[i++] = c;
+    }
+    if (escape_controls_) {
+        for (size_t c = 0; c <= static_cast<size_t>(LAST_CONTROL); ++c) {
+            if (!is_special_[c]) {
+                replacements_[c] = CONTROL_ESCAPES[c];
+                is_special_[c] = true;
+            }
+        }
+    }
+}
+
+size_t Escaper::FindSpecial(std::string_view text, size_t pos) const {
+    const char* const data = text.data();
+    const size_t size = text.size();
+#if defined(__AVX2__)
+    for (; pos + 32 <= size; pos += 32) {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+        __m256i found = _mm256_setzero_si256();
+        if (escape_controls_) {
+            // Байт не больше 0x1F: вычитание с насыщением даёт ноль
+            found = _mm256_cmpeq_epi8(_mm256_subs_epu8(block, _mm256_set1_epi8(LAST_CONTROL)),
+                                      _mm256_setzero_si256());
+        }
+        for (char c : specials_) {
+            found = _mm256_or_si256(found, _mm256_cmpeq_epi8(block, _mm256_set1_epi8(c)));
+        }
+        if (const auto mask = static_cast<unsigned>(_mm256_movemask_epi8(found))) {
+            return pos + __builtin_ctz(mask);
+        }
+    }
+#elif defined(__SSE2__)
+    for (; pos + 16 <= size; pos += 16) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        __m128i found = _mm_setzero_si128();
+        if (escape_controls_) {
+            // Байт не больше 0x1F: вычитание с насыщением даёт ноль
+            found = _mm_cmpeq_epi8(_mm_subs_epu8(block, _mm_set1_epi8(LAST_CONTROL)), _mm_setzero_si128());
+        }
+        for (char c : specials_) {
+            found = _mm_or_si128(found, _mm_cmpeq_epi8(block, _mm_set1_epi8(c)));
+        }
+        if (const auto mask = static_cast<unsigned>(_mm_movemask_epi8(found))) {
+            return pos + __builtin_ctz(mask);
+        }
+    }
+#endif
+    // Хвост короче блока (или платформа без SIMD) — по таблице
+    for (; pos < size; ++pos) {
+        if (is_special_[static_cast<unsigned char>(data[pos])]) {
+            return pos;
+        }
+    }
+    return size;
+}
+
+void Escaper::Append(std::string& out, std::string_view text) const {
+    Escape(text, [&out](std::string_view part) {
+        out.append(part);
+    });
+}
+
+void Escaper::Write(std::ostream& out, std::string_view text) const {
+    Escape(text, [&out](std::string_view part) {
+        out.write(part.data(), part.size());
+    });
+}
+
+std::string Escaper::Escaped(std::string_view text) const {
+    std::string result;
+    result.reserve(text.size());
+    Append(result, text);
+    return result;
+}
+
+const Escaper& Json() {
+    static const Escaper escaper{{
+        {'"', "\\\""sv},
+        {'\\', "\\\\"sv},
+        {'\n', "\\n"sv},
+        {'\r', "\\r"sv},
+        {'\t', "\\t"sv},
+    }, true};
+    return escaper;
+}
+
+const Escaper& Xml() {
+    static const Escaper escaper{
+        {'"', "&quot;"sv},
+        {'\'', "&apos;"sv},
+        {'<', "&lt;"sv},
+        {'>', "&gt;"sv},
+        {'&', "&amp;"sv},
+    };
+    return escaper;
+}
+
+}  // namespace escape
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <initializer_list>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace escape {
+
+// Экранирование текста по таблице замен. Символы, которые нужно заменить,
+// ищутся блоками по 16 (SSE2) или 32 (AVX2) байта, участки без них
+// передаются дальше целиком, одной записью
+class Escaper {
+public:
+    static constexpr size_t MAX_SPECIALS = 8;
+
+    // escape_controls — заменяются и все управляющие символы 0x00..0x1F:
+    // те, что не заданы в replacements, — на \u00XX
+    Escaper(std::initializer_list<std::pair<char, std::string_view>> replacements, bool escape_controls = false);
+
+    // Позиция первого символа из таблицы замен, начиная с pos, либо text.size()
+    size_t FindSpecial(std::string_view text, size_t pos = 0) const;
+
+    // Передаёт в sink(std::string_view) по очереди чистые участки текста и замены
+    template <typename Sink>
+    void Escape(std::string_view text, Sink&& sink) const {
+        for (size_t pos = 0; pos < text.size();) {
+            const size_t special = FindSpecial(text, pos);
+            if (special > pos) {
+                sink(text.substr(pos, special - pos));
+            }
+            if (special == text.size()) {
+                break;
+            }
+            sink(replacements_[static_cast<unsigned char>(text[special])]);
+            pos = special + 1;
+        }
+    }
+
+    void Append(std::string& out, std::string_view text) const;
+    void Write(std::ostream& out, std::string_view text) const;
+    std::string Escaped(std::string_view text) const;
+
+private:
+    std::array<std::string_view, 256> replacements_;
+    std::array<bool, 256> is_special_{};
+    // Неиспользуемые позиции дублируют первый символ, чтобы в цикле
+    // поиска всегда было ровно MAX_SPECIALS сравнений
+    std::array<char, MAX_SPECIALS> specials_{};
+    // Управляющие символы ищутся одним сравнением диапазона
+    bool escape_controls_ = false;
+};
+
+// Строки JSON: ", \, \n, \r, \t и остальные управляющие символы как \u00XX
+const Escaper& Json();
+// Текст и атрибуты XML/SVG: ", ', <, >, &
+const Escaper& Xml();
+
+}  // namespace escape
@@ -1,11 +1,21 @@
 #include "json.h"
+#include "escape.h"
+#include <algorithm>
+#include <array>
 #include <cctype>
+#include <charconv>
+#include <cstdint>
 #include <sstream>
 #include <cassert>
 #include <iostream>
+#include <iterator>
+#include <limits>
 #include <string>
 
 namespace json {
+
+using namespace std::literals;
+
 bool operator==(const Node& lhs, const Array& rhs) {
     if (!lhs.IsArray()) {
         return false;
@@ -30,77 +40,98 @@ bool operator!=(const Array& lhs, const Node& rhs) {
 }
 namespace {
 
-Node LoadNode(std::istream& input);
+Node LoadNode(std::istream& input, StringPool* pool);
+
+// Буфер потока поверх уже прочитанного текста: позволяет разбирать
+// его фрагменты без копирования
+class ViewBuffer : public std::streambuf {
+public:
+    explicit ViewBuffer(std::string_view text) {
+        char* begin = const_cast<char*>(text.data());
+        setg(begin, begin, begin + text.size());
+    }
+
+    size_t Position() const {
+        return gptr() - eback();
+    }
+};
 
 using Number = std::variant<int, double>;
 
+// Текст уже проверен по грамматике JSON; is_int — в нём нет дробной части и порядка
+Number ToNumber(std::string_view text, bool is_int) {
+    const char* first = text.data();
+    const char* last = first + text.size();
+    if (is_int) {
+        int value;
+        if (auto [ptr, ec] = std::from_chars(first, last, value); ec == std::errc{} && ptr == last) {
+            return value;
+        }
+        // Не поместилось в int — читаем как double
+    }
+    double value;
+    if (auto [ptr, ec] = std::from_chars(first, last, value); ec == std::errc{} && ptr == last) {
+        return value;
+    }
+    throw ParsingError("Failed to convert "s + std::string(text) + " to number"s);
+}
+
 Number LoadNumber(std::istream& input) {
     using namespace std::literals;
+    // Читаем напрямую из буфера потока: istream::get/peek заметно дороже.
+    // Короткие числа помещаются в std::string без выделения памяти
+    std::streambuf& buffer = *input.rdbuf();
     std::string parsed_num;
-    auto read_char = [&parsed_num, &input] {
-        parsed_num += static_cast<char>(input.get());
-        if (!input) {
-            throw ParsingError("Failed to read number from stream"s);
-        }
+    auto read_char = [&parsed_num, &buffer] {
+        parsed_num += static_cast<char>(buffer.sbumpc());
     };
 
-    auto read_digits = [&input, read_char] {
-        if (!std::isdigit(input.peek())) {
+    auto read_digits = [&buffer, read_char] {
+        if (!std::isdigit(buffer.sgetc())) {
             throw ParsingError("A digit is expected"s);
         }
-        while (std::isdigit(input.peek())) {
+        while (std::isdigit(buffer.sgetc())) {
             read_char();
         }
     };
 
-    if (input.peek() == '-') {
+    if (buffer.sgetc() == '-') {
         read_char();
     }
 
-    if (input.peek() == '0') {
+    if (buffer.sgetc() == '0') {
         read_char();
     } else {
         read_digits();
     }
 
     bool is_int = true;
-    if (input.peek() == '.') {
+    if (buffer.sgetc() == '.') {
         read_char();
         read_digits();
         is_int = false;
     }
 
-    if (int ch = input.peek(); ch == 'e' || ch == 'E') {
+    if (int ch = buffer.sgetc(); ch == 'e' || ch == 'E') {
         read_char();
-        if (ch = input.peek(); ch == '+' || ch == '-') {
+        if (ch = buffer.sgetc(); ch == '+' || ch == '-') {
             read_char();
         }
         read_digits();
         is_int = false;
     }
 
-    try {
-        if (is_int) {
-            try {
-                return std::stoi(parsed_num);
-            } catch (...) {
-                // Fall through to double parsing
-            }
-        }
-        return std::stod(parsed_num);
-    } catch (...) {
-        throw ParsingError("Failed to convert "s + parsed_num + " to number"s);
-    }
+    return ToNumber(parsed_num, is_int);
 }
 
-Node LoadArray(std::istream& input) {
+Node LoadArray(std::istream& input, StringPool* pool) {
     std::vector<Node> result;
 
     for (char c; input >> c && c != ']';) {
         if (c != ',') {
             input.putback(c);
         }
-        result.push_back(LoadNode(input));
+        result.push_back(LoadNode(input, pool));
     }
     if (!input) {
         throw ParsingError("Array parsing error");
@@ -116,11 +147,101 @@ Node LoadNumberNode(std::istream& input) {
         return Node(std::get<double>(number));
     }
 }
-std::string LString(std::istream& input) {
+// Символ, который обозначает escape-последовательность \escaped_char
+char Unescape(char escaped_char) {
+    switch (escaped_char) {
+    case 'n':
+        return '\n';
+    case 't':
+        return '\t';
+    case 'r':
+        return '\r';
+    case 'b':
+        return '\b';
+    case 'f':
+        return '\f';
+    case '"':
+        return '"';
+    case '\\':
+        return '\\';
+    case '/':
+        return '/';
+    default:
+        throw ParsingError("Unrecognized escape sequence \\"s + escaped_char);
+    }
+}
+
+// Четыре шестнадцатеричные цифры \uXXXX; next() отдаёт очередной символ
+template <typename NextChar>
+uint32_t ReadCodeUnit(NextChar& next) {
+    uint32_t code = 0;
+    for (int i = 0; i < 4; ++i) {
+        const char ch = next();
+        uint32_t digit = 0;
+        if (ch >= '0' && ch <= '9') {
+            digit = ch - '0';
+        } else if (ch >= 'a' && ch <= 'f') {
+            digit = ch - 'a' + 10;
+        } else if (ch >= 'A' && ch <= 'F') {
+            digit = ch - 'A' + 10;
+        } else {
+            throw ParsingError("Invalid \\u escape sequence");
+        }
+        code = code * 16 + digit;
+    }
+    return code;
+}
+
+void AppendUtf8(std::string& s, uint32_t code) {
+    if (code < 0x80) {
+        s.push_back(static_cast<char>(code));
+    } else if (code < 0x800) {
+        s.push_back(static_cast<char>(0xC0 | (code >> 6)));
+        s.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    } else if (code < 0x10000) {
+        s.push_back(static_cast<char>(0xE0 | (code >> 12)));
+        s.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+        s.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    } else {
+        s.push_back(static_cast<char>(0xF0 | (code >> 18)));
+        s.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+        s.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+        s.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    }
+}
+
+// Дописывает в s символ escape-последовательности \escaped_char. Для \uXXXX
+// остальные символы берутся из next(), символ пишется в UTF-8; символ вне
+// BMP записывается суррогатной парой \uD8XX\uDCXX
+template <typename NextChar>
+void AppendUnescaped(std::string& s, char escaped_char, NextChar next) {
+    if (escaped_char != 'u') {
+        s.push_back(Unescape(escaped_char));
+        return;
+    }
+    uint32_t code = ReadCodeUnit(next);
+    if (code >= 0xDC00 && code <= 0xDFFF) {
+        throw ParsingError("Unpaired surrogate in \\u escape sequence");
+    }
+    if (code >= 0xD800 && code <= 0xDBFF) {
+        if (next() != '\\' || next() != 'u') {
+            throw ParsingError("Unpaired surrogate in \\u escape sequence");
+        }
+        const uint32_t low = ReadCodeUnit(next);
+        if (low < 0xDC00 || low > 0xDFFF) {
+            throw ParsingError("Unpaired surrogate in \\u escape sequence");
+        }
+        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+    }
+    AppendUtf8(s, code);
+}
+
+// Декодирует строку в s, переиспользуя его память
+void LString(std::istream& input, std::string& s) {
     using namespace std::literals;
     auto it = std::istreambuf_iterator<char>(input);
     auto end = std::istreambuf_iterator<char>();
-    std::string s;
+    s.clear();
     while (true) {
         if (it == end) {
             throw ParsingError("String parsing error");
@@ -134,26 +255,12 @@ std::string LString(std::istream& input) {
             if (it == end) {
                 throw ParsingError("String parsing error");
             }
-            const char escaped_char = *(it);
-            switch (escaped_char) {
-            case 'n':
-                s.push_back('\n');
-                break;
-            case 't':
-                s.push_back('\t');
-                break;
-            case 'r':
-                s.push_back('\r');
-                break;
-            case '"':
-                s.push_back('"');
-                break;
-            case '\\':
-                s.push_back('\\');
-                break;
-            default:
-                throw ParsingError("Unrecognized escape sequence \\"s + escaped_char);
-            }
+            AppendUnescaped(s, *it, [&it, &end] {
+                if (++it == end) {
+                    throw ParsingError("String parsing error");
+                }
+                return *it;
+            });
         } else if (ch == '\n' || ch == '\r') {
             throw ParsingError("Unexpected end of line"s);
         } else {
@@ -161,12 +268,31 @@ std::string LString(std::istream& input) {
         }
         ++it;
     }
+}
+std::string LString(std::istream& input) {
+    std::string s;
+    LString(input, s);
     return s;
 }
-Node LoadString(std::istream& input) {
-    return Node(LString(input));
+Node LoadString(std::istream& input, StringPool* pool) {
+    if (!pool) {
+        return Node(LString(input));
+    }
+    // Строка декодируется в общий буфер и копируется в пул только при первой встрече
+    thread_local std::string scratch;
+    LString(input, scratch);
+    return Node(InternedString{&pool->Intern(scratch)});
 }
-Node LoadDict(std::istream& input) {
+DictKey LoadKey(std::istream& input, StringPool* pool) {
+    if (!pool) {
+        return LString(input);
+    }
+    // Ключи повторяются во всех словарях документа: в пуле каждый хранится один раз
+    thread_local std::string scratch;
+    LString(input, scratch);
+    return InternedString{&pool->Intern(scratch)};
+}
+Node LoadDict(std::istream& input, StringPool* pool) {
     Dict result;
 
     for (char c; input >> c && c != '}';) {
@@ -174,9 +300,9 @@ Node LoadDict(std::istream& input) {
             input >> c;
         }
 
-        std::string key = LoadString(input).AsString();
+        DictKey key = LoadKey(input, pool);
         input >> c;
-        result.insert({move(key), LoadNode(input)});
+        result.insert({std::move(key), LoadNode(input, pool)});
     }
     if (!input) {
         throw ParsingError("Map parsing error");
@@ -211,7 +337,232 @@ Node LoadNull(std::istream& input) {
 }
 
 
-Node LoadNode(std::istream& input) {
+// Пропускает строку, открывающая кавычка которой уже прочитана
+void SkipString(std::istream& input) {
+    for (int ch = input.get(); ch != '"'; ch = input.get()) {
+        if (ch == std::char_traits<char>::eof()) {
+            throw ParsingError("String parsing error");
+        }
+        if (ch == '\\') {
+            input.get();
+        }
+    }
+}
+
+// Пропускает значение любого типа, не создавая узлов
+void SkipValue(std::istream& input) {
+    input >> std::ws;
+    const int first = input.peek();
+    if (first != '[' && first != '{' && first != '"') {
+        // Число или литерал true/false/null
+        for (int ch = input.peek(); ch != std::char_traits<char>::eof()
+                                    && ch != ',' && ch != ']' && ch != '}'
+                                    && !std::isspace(ch); ch = input.peek()) {
+            input.get();
+        }
+        return;
+    }
+    int depth = 0;
+    do {
+        switch (input.get()) {
+        case std::char_traits<char>::eof():
+            throw ParsingError("Unexpected end of input");
+        case '"':
+            SkipString(input);
+            break;
+        case '[':
+        case '{':
+            ++depth;
+            break;
+        case ']':
+        case '}':
+            --depth;
+            break;
+        }
+    } while (depth > 0);
+}
+
+// Разбор по уже прочитанному тексту: text сдвигается за разобранную часть
+
+void SkipSpaces(std::string_view& text) {
+    while (!text.empty() && std::isspace(static_cast<unsigned char>(text.front()))) {
+        text.remove_prefix(1);
+    }
+}
+
+// Следующий непробельный символ; '\0' — текст закончился
+char NextChar(std::string_view& text) {
+    SkipSpaces(text);
+    if (text.empty()) {
+        return '\0';
+    }
+    const char c = text.front();
+    text.remove_prefix(1);
+    return c;
+}
+
+// Декодирует строку, открывающая кавычка которой уже пропущена
+void LString(std::string_view& text, std::string& s) {
+    s.clear();
+    for (;;) {
+        // Участки без escape-последовательностей копируются целиком
+        const size_t special = text.find_first_of("\"\\\n\r"sv);
+        if (special == std::string_view::npos) {
+            throw ParsingError("String parsing error");
+        }
+        s.append(text.data(), special);
+        const char ch = text[special];
+        text.remove_prefix(special + 1);
+        if (ch == '"') {
+            return;
+        }
+        if (ch != '\\') {
+            throw ParsingError("Unexpected end of line"s);
+        }
+        if (text.empty()) {
+            throw ParsingError("String parsing error");
+        }
+        const char escaped_char = text.front();
+        text.remove_prefix(1);
+        AppendUnescaped(s, escaped_char, [&text] {
+            if (text.empty()) {
+                throw ParsingError("String parsing error");
+            }
+            const char ch = text.front();
+            text.remove_prefix(1);
+            return ch;
+        });
+    }
+}
+
+// Пропускает строку, открывающая кавычка которой уже пропущена
+void SkipString(std::string_view& text) {
+    // Внутри строки важны только кавычка и экранирование
+    for (;;) {
+        const size_t end = text.find_first_of("\"\\"sv);
+        const bool escaped = end != std::string_view::npos && text[end] == '\\';
+        if (end == std::string_view::npos || (escaped && end + 1 == text.size())) {
+            throw ParsingError("String parsing error");
+        }
+        text.remove_prefix(end + (escaped ? 2 : 1));
+        if (!escaped) {
+            return;
+        }
+    }
+}
+
+// Пропускает значение любого типа; пробелы перед ним уже пропущены
+void SkipValue(std::string_view& text) {
+    if (text.empty()) {
+        throw ParsingError("Unexpected end of input");
+    }
+    const char first = text.front();
+    if (first != '[' && first != '{' && first != '"') {
+        // Число или литерал true/false/null
+        size_t end = 0;
+        while (end < text.size() && text[end] != ',' && text[end] != ']' && text[end] != '}'
+               && !std::isspace(static_cast<unsigned char>(text[end]))) {
+            ++end;
+        }
+        text.remove_prefix(end);
+        return;
+    }
+    int depth = 0;
+    do {
+        const size_t special = text.find_first_of("\"[]{}"sv);
+        if (special == std::string_view::npos) {
+            throw ParsingError("Unexpected end of input");
+        }
+        const char ch = text[special];
+        text.remove_prefix(special + 1);
+        if (ch == '"') {
+            SkipString(text);
+        } else if (ch == '[' || ch == '{') {
+            ++depth;
+        } else {
+            --depth;
+        }
+    } while (depth > 0);
+}
+
+// Число, занимающее весь text, по грамматике JSON:
+// -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+Number ParseNumber(std::string_view text) {
+    size_t pos = 0;
+    auto skip_digits = [&text, &pos] {
+        const size_t start = pos;
+        while (pos < text.size() && std::isdigit(static_cast<unsigned char>(text[pos]))) {
+            ++pos;
+        }
+        if (pos == start) {
+            throw ParsingError("A digit is expected"s);
+        }
+    };
+    if (pos < text.size() && text[pos] == '-') {
+        ++pos;
+    }
+    if (pos < text.size() && text[pos] == '0') {
+        ++pos;
+    } else {
+        skip_digits();
+    }
+    bool is_int = true;
+    if (pos < text.size() && text[pos] == '.') {
+        ++pos;
+        skip_digits();
+        is_int = false;
+    }
+    if (pos < text.size() && (text[pos] == 'e' || text[pos] == 'E')) {
+        ++pos;
+        if (pos < text.size() && (text[pos] == '+' || text[pos] == '-')) {
+            ++pos;
+        }
+        skip_digits();
+        is_int = false;
+    }
+    if (pos != text.size()) {
+        throw ParsingError("Failed to convert "s + std::string(text) + " to number"s);
+    }
+    return ToNumber(text, is_int);
+}
+
+// Значение, занимающее весь text. Строки, числа и литералы разбираются
+// прямо по тексту; массивы и словари в запросах редки и идут через LoadNode
+Node ParseValue(std::string_view text) {
+    if (text.empty()) {
+        throw ParsingError("Unexpected end of input");
+    }
+    switch (text.front()) {
+    case '"': {
+        std::string value;
+        text.remove_prefix(1);
+        LString(text, value);
+        return Node(std::move(value));
+    }
+    case '[':
+    case '{': {
+        ViewBuffer buffer(text);
+        std::istream input(&buffer);
+        return LoadNode(input, nullptr);
+    }
+    }
+    if (text == "true"sv) {
+        return Node(true);
+    }
+    if (text == "false"sv) {
+        return Node(false);
+    }
+    if (text == "null"sv) {
+        return Node(nullptr);
+    }
+    const Number number = ParseNumber(text);
+    if (std::holds_alternative<int>(number)) {
+        return Node(std::get<int>(number));
+    }
+    return Node(std::get<double>(number));
+}
+
+Node LoadNode(std::istream& input, StringPool* pool) {
     input >> std::ws;
     char c;
     input >> c;
@@ -221,11 +572,11 @@ Node LoadNode(std::istream& input) {
     }
 
     if (c == '[') {
-        return LoadArray(input);
+        return LoadArray(input, pool);
     } else if (c == '{') {
-        return LoadDict(input);
+        return LoadDict(input, pool);
     } else if (c == '"') {
-        return LoadString(input);
+        return LoadString(input, pool);
     } else if (c == 't' || c == 'f') {
         input.putback(c);
         return LoadBool(input);
@@ -269,6 +620,9 @@ const std::string& Node::AsString() const {
     if (std::holds_alternative<std::string>(value_)) {
         return std::get<std::string>(value_);
     }
+    if (std::holds_alternative<InternedString>(value_)) {
+        return *std::get<InternedString>(value_).value;
+    }
     throw std::logic_error("Node does not contain a string");
 }
 
@@ -287,6 +641,10 @@ const Dict& Node::AsMap() const {
 }
 
 bool Node::operator==(const Node& other) const {
+    // Обычная и интернированная строки с одинаковым текстом равны
+    if (IsString() && other.IsString()) {
+        return AsString() == other.AsString();
+    }
     if (value_.index() != other.value_.index()) {
         return false;
     }
@@ -306,71 +664,296 @@ bool Node::operator!=(const Node& other) const {
 }
 
 Document Load(std::istream& input) {
-    return Document{LoadNode(input)};
+    return Document{LoadNode(input, nullptr)};
 }
 
-template <typename Value>
-void PrintValue(const Value& value, std::ostream& out) {
-    out << value;
+Document Load(std::istream& input, StringPool& pool) {
+    return Document{LoadNode(input, &pool)};
+}
+
+const std::string& StringPool::Intern(std::string_view value) {
+    ++request_count_;
+    if (auto it = index_.find(value); it != index_.end()) {
+        return *it->second;
+    }
+    const std::string& stored = strings_.emplace_back(value);
+    stored_bytes_ += stored.size();
+    index_.emplace(stored, &stored);
+    return stored;
+}
+
+const std::vector<RawDict::Field>& RawDict::GetFields() const {
+    if (indexed_) {
+        return fields_;
+    }
+    if (text_.size() > std::numeric_limits<uint32_t>::max()) {
+        throw ParsingError("Map is too large");
+    }
+    std::string_view text = text_;
+    const auto offset = [this](std::string_view rest) {
+        return static_cast<uint32_t>(text_.size() - rest.size());
+    };
+    // Поля собираются в общий буфер, чтобы оглавление заняло ровно одно выделение памяти
+    thread_local std::vector<Field> fields;
+    fields.clear();
+    if (NextChar(text) != '{') {
+        throw ParsingError("Map parsing error");
+    }
+    char c = NextChar(text);
+    while (c != '}') {
+        if (c != '"') {
+            throw ParsingError("Map parsing error");
+        }
+        Field field;
+        field.key_begin = offset(text);
+        SkipString(text);
+        field.key_size = offset(text) - field.key_begin - 1;
+        if (NextChar(text) != ':') {
+            throw ParsingError("Map parsing error");
+        }
+        SkipSpaces(text);
+        field.value_begin = offset(text);
+        SkipValue(text);
+        field.value_size = offset(text) - field.value_begin;
+        fields.push_back(field);
+        c = NextChar(text);
+        if (c == ',') {
+            c = NextChar(text);
+        } else if (c != '}') {
+            throw ParsingError("Map parsing error");
+        }
+    }
+    fields_.assign(fields.begin(), fields.end());
+    indexed_ = true;
+    return fields_;
 }
 
-void PrintValue(std::nullptr_t, std::ostream& out) {
-    out << "null";
+std::optional<Node> RawDict::Find(std::string_view key) const {
+    for (const Field& field : GetFields()) {
+        const std::string_view raw_key = text_.substr(field.key_begin, field.key_size);
+        // Ключ с escape-последовательностями сравнивается только декодированным:
+        // его исходный текст может совпасть с другим искомым ключом
+        const bool escaped = raw_key.find('\\') != std::string_view::npos;
+        bool found = !escaped && raw_key == key;
+        if (escaped) {
+            std::string decoded;
+            std::string_view rest = text_.substr(field.key_begin);
+            LString(rest, decoded);
+            found = decoded == key;
+        }
+        if (found) {
+            return ParseValue(text_.substr(field.value_begin, field.value_size));
+        }
+    }
+    return std::nullopt;
 }
 
-void PrintValue(bool value, std::ostream& out) {
-    out << (value ? "true" : "false");
+Node RawDict::at(std::string_view key) const {
+    auto value = Find(key);
+    if (!value) {
+        throw std::out_of_range("No key "s + std::string(key) + " in map"s);
+    }
+    return std::move(*value);
 }
 
-void PrintValue(const std::string& value, std::ostream& out) {
-    out << '"';
-    for (char c : value) {
-        switch (c) {
-        case '"':  out << "\\\""; break;
-        case '\\': out << "\\\\"; break;
-        case '\n': out << "\\n";  break;
-        case '\r': out << "\\r";  break;
-        case '\t': out << "\\t";  break;
-        default:   out << c;
+LazyDocument::LazyDocument(std::istream& input, const std::vector<std::string>& lazy_keys,
+                           StringPool* pool)
+    : text_(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>()) {
+    ViewBuffer buffer(text_);
+    std::istream text_input(&buffer);
+    char c;
+    if (!(text_input >> c) || c != '{') {
+        throw ParsingError("Map parsing error");
+    }
+    for (; text_input >> c && c != '}';) {
+        if (c == ',') {
+            text_input >> c;
+        }
+        std::string key = LString(text_input);
+        text_input >> c;
+        if (std::find(lazy_keys.begin(), lazy_keys.end(), key) == lazy_keys.end()) {
+            root_.insert({std::move(key), LoadNode(text_input, pool)});
+            continue;
+        }
+        // Запоминаем только границы элементов массива
+        auto& items = lazy_arrays_[std::move(key)];
+        if (!(text_input >> c) || c != '[') {
+            throw ParsingError("Array parsing error");
         }
+        for (; text_input >> c && c != ']';) {
+            if (c != ',') {
+                text_input.putback(c);
+            }
+            text_input >> std::ws;
+            const size_t begin = buffer.Position();
+            SkipValue(text_input);
+            items.emplace_back(std::string_view(text_).substr(begin, buffer.Position() - begin));
+        }
+    }
+    if (!text_input) {
+        throw ParsingError("Map parsing error");
+    }
+}
+
+const std::vector<RawDict>& LazyDocument::GetLazyArray(const std::string& key) const {
+    static const std::vector<RawDict> empty;
+    auto it = lazy_arrays_.find(key);
+    return it != lazy_arrays_.end() ? it->second : empty;
+}
+
+StreamReader::StreamReader(std::istream& input, StringPool* pool)
+    : input_(input), pool_(pool) {
+    char c;
+    if (!(input_ >> c) || c != '{') {
+        throw ParsingError("Map parsing error");
+    }
+}
+
+std::optional<std::string> StreamReader::NextKey() {
+    char c;
+    if (!(input_ >> c)) {
+        throw ParsingError("Map parsing error");
     }
-    out << '"';
+    if (c == '}') {
+        return std::nullopt;
+    }
+    if (c == ',') {
+        input_ >> c;
+    }
+    std::string key = LString(input_);
+    input_ >> c;
+    return key;
+}
+
+Node StreamReader::ReadValue() {
+    return LoadNode(input_, pool_);
+}
+
+void StreamReader::StartArray() {
+    char c;
+    if (!(input_ >> c) || c != '[') {
+        throw ParsingError("Array parsing error");
+    }
+}
+
+std::optional<Node> StreamReader::NextItem() {
+    char c;
+    if (!(input_ >> c)) {
+        throw ParsingError("Array parsing error");
+    }
+    if (c == ']') {
+        return std::nullopt;
+    }
+    if (c != ',') {
+        input_.putback(c);
+    }
+    return LoadNode(input_, pool_);
+}
+
+namespace {
+
+// Буфера хватает на любое int и double в любом из форматов
+using NumberChars = std::array<char, 32>;
+
+std::string_view FormatNumber(NumberChars& chars, int value) {
+    const auto result = std::to_chars(chars.data(), chars.data() + chars.size(), value);
+    return {chars.data(), static_cast<size_t>(result.ptr - chars.data())};
+}
+
+std::string_view FormatNumber(NumberChars& chars, double value, DoubleFormat format) {
+    char* const first = chars.data();
+    char* const last = first + chars.size();
+    const auto result = format == DoubleFormat::SHORTEST
+        ? std::to_chars(first, last, value)
+        : std::to_chars(first, last, value, std::chars_format::general, STREAM_PRECISION);
+    return {first, static_cast<size_t>(result.ptr - first)};
+}
+
+} // namespace
+
+void AppendNumber(std::string& out, int value) {
+    NumberChars chars;
+    out += FormatNumber(chars, value);
 }
 
-void PrintNode(const Node& node, std::ostream& out) {
-    std::visit([&out](const auto& value) { PrintValue(value, out); }, node.GetValue());
+void AppendNumber(std::string& out, double value, DoubleFormat format) {
+    NumberChars chars;
+    out += FormatNumber(chars, value, format);
 }
 
-void PrintValue(const Array& array, std::ostream& out) {
-    out << '[';
+namespace {
+
+struct PrintContext {
+    std::ostream& out;
+    DoubleFormat double_format;
+};
+
+void PrintNode(const Node& node, const PrintContext& ctx);
+
+void PrintValue(int value, const PrintContext& ctx) {
+    NumberChars chars;
+    ctx.out << FormatNumber(chars, value);
+}
+
+void PrintValue(double value, const PrintContext& ctx) {
+    NumberChars chars;
+    ctx.out << FormatNumber(chars, value, ctx.double_format);
+}
+
+void PrintValue(std::nullptr_t, const PrintContext& ctx) {
+    ctx.out << "null";
+}
+
+void PrintValue(bool value, const PrintContext& ctx) {
+    ctx.out << (value ? "true" : "false");
+}
+
+void PrintValue(const std::string& value, const PrintContext& ctx) {
+    ctx.out << '"';
+    escape::Json().Write(ctx.out, value);
+    ctx.out << '"';
+}
+
+void PrintValue(InternedString value, const PrintContext& ctx) {
+    PrintValue(*value.value, ctx);
+}
+
+void PrintValue(const Array& array, const PrintContext& ctx) {
+    ctx.out << '[';
     bool first = true;
     for (const auto& item : array) {
         if (!first) {
-            out << ',';
+            ctx.out << ',';
         }
         first = false;
-        PrintNode(item, out);
+        PrintNode(item, ctx);
     }
-    out << ']';
+    ctx.out << ']';
 }
 
-void PrintValue(const Dict& dict, std::ostream& out) {
-    out << '{';
+void PrintValue(const Dict& dict, const PrintContext& ctx) {
+    ctx.out << '{';
     bool first = true;
     for (const auto& [key, value] : dict) {
         if (!first) {
-            out << ',';
+            ctx.out << ',';
         }
         first = false;
-        PrintValue(key, out);
-        out << ':';
-        PrintNode(value, out);
+        PrintValue(key, ctx);
+        ctx.out << ':';
+        PrintNode(value, ctx);
     }
-    out << '}';
+    ctx.out << '}';
+}
+
+void PrintNode(const Node& node, const PrintContext& ctx) {
+    std::visit([&ctx](const auto& value) { PrintValue(value, ctx); }, node.GetValue());
 }
 
-void Print(const Document& doc, std::ostream& output) {
-    PrintNode(doc.GetRoot(), output);
+} // namespace
+
+void Print(const Document& doc, std::ostream& output, DoubleFormat double_format) {
+    PrintNode(doc.GetRoot(), PrintContext{output, double_format});
 }
 
 } // namespace json
@@ -1,7 +1,12 @@
 #pragma once
+#include <cstdint>
+#include <deque>
 #include <iostream>
 #include <map>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 #include <variant>
 #include <stdexcept>
@@ -9,8 +14,42 @@
 namespace json {
 
 class Node;
+
+// Строка из StringPool: узел хранит только указатель на неё
+struct InternedString {
+    const std::string* value;
+};
+
+inline bool operator==(InternedString lhs, InternedString rhs) {
+    return *lhs.value == *rhs.value;
+}
+
+// Ключ словаря. Ключ, разобранный с StringPool, ссылается на строку пула
+// и не выделяет памяти даже для длинных имён; остальные хранят строку сами
+class DictKey {
+public:
+    DictKey(std::string value) : owned_(std::move(value)) {}
+    DictKey(const char* value) : owned_(value) {}
+    DictKey(InternedString value) : interned_(value.value) {}
+
+    const std::string& Get() const { return interned_ ? *interned_ : owned_; }
+    operator const std::string&() const { return Get(); }
+
+private:
+    const std::string* interned_ = nullptr;
+    std::string owned_;
+};
+
+inline bool operator==(const DictKey& lhs, const DictKey& rhs) {
+    return lhs.Get() == rhs.Get();
+}
+
+inline bool operator<(const DictKey& lhs, const DictKey& rhs) {
+    return lhs.Get() < rhs.Get();
+}
+
 using Array = std::vector<Node>;
-using Dict = std::map<std::string, Node>;
+using Dict = std::map<DictKey, Node>;
 
 class ParsingError : public std::runtime_error {
 public:
@@ -19,7 +58,8 @@ public:
 
 class Node {
 public:
-    using Value = std::variant<std::nullptr_t, int, double, bool, std::string, Array, Dict>;
+    using Value = std::variant<std::nullptr_t, int, double, bool, std::string, Array, Dict,
+                               InternedString>;
     Node() : value_(nullptr) {}
     Node(Array array) : value_(std::move(array)) {}
     Node(Dict map) : value_(std::move(map)) {}
@@ -29,6 +69,7 @@ public:
     Node(std::string value) : value_(std::move(value)) {}  // Made non-explicit
     Node(const char* value) : value_(std::string(value)) {}  // Added for string literals
     Node(std::nullptr_t) : value_(nullptr) {}  // Added for nullptr
+    Node(InternedString value) : value_(value) {}
     
 
     bool IsNull() const { return std::holds_alternative<std::nullptr_t>(value_); }
@@ -36,7 +77,10 @@ public:
     bool IsDouble() const { return std::holds_alternative<double>(value_) || std::holds_alternative<int>(value_); }
     bool IsPureDouble() const { return std::holds_alternative<double>(value_); }
     bool IsBool() const { return std::holds_alternative<bool>(value_); }
-    bool IsString() const { return std::holds_alternative<std::string>(value_); }
+    bool IsString() const {
+        return std::holds_alternative<std::string>(value_)
+               || std::holds_alternative<InternedString>(value_);
+    }
     bool IsArray() const { return std::holds_alternative<Array>(value_); }
     bool IsMap() const { return std::holds_alternative<Dict>(value_); }
 
@@ -69,8 +113,115 @@ private:
     Node root_;
 };
 
+// Политика вывода чисел с плавающей точкой
+enum class DoubleFormat {
+    STREAM,    // как std::ostream по умолчанию: 6 значащих цифр
+    SHORTEST,  // кратчайшая запись, которая читается обратно в то же число
+};
+inline constexpr int STREAM_PRECISION = 6;
+
+// Таблица интернирования строк: одинаковые строки хранятся один раз,
+// ссылки на них остаются действительными, пока жив пул
+class StringPool {
+public:
+    StringPool() = default;
+    StringPool(const StringPool&) = delete;
+    StringPool& operator=(const StringPool&) = delete;
+
+    const std::string& Intern(std::string_view value);
+
+    size_t GetSize() const { return strings_.size(); }
+    size_t GetRequestCount() const { return request_count_; }
+    size_t GetStoredBytes() const { return stored_bytes_; }
+
+private:
+    std::deque<std::string> strings_;
+    std::unordered_map<std::string_view, const std::string*> index_;
+    size_t request_count_ = 0;
+    size_t stored_bytes_ = 0;
+};
+
 Document Load(std::istream& input);
-void Print(const Document& doc, std::ostream& output);
+// Строковые значения и ключи словарей документа интернируются в pool,
+// и документ не должен пережить его
+Document Load(std::istream& input, StringPool& pool);
+void Print(const Document& doc, std::ostream& output,
+           DoubleFormat double_format = DoubleFormat::STREAM);
+
+// Дописывают текстовое представление числа в конец out
+void AppendNumber(std::string& out, int value);
+void AppendNumber(std::string& out, double value, DoubleFormat format = DoubleFormat::STREAM);
+
+// Словарь, который ещё не разобран: хранит диапазон байтов исходного текста
+// и декодирует только запрошенные поля в момент обращения к ним.
+// Первое обращение один раз находит границы всех полей, дальше поиск
+// идёт по этому оглавлению. Поэтому один RawDict не читают из нескольких
+// потоков одновременно; разные — можно
+class RawDict {
+public:
+    explicit RawDict(std::string_view text) : text_(text) {}
+
+    std::optional<Node> Find(std::string_view key) const;
+    // Как Dict::at: бросает std::out_of_range, если ключа нет
+    Node at(std::string_view key) const;
+
+    std::string_view GetText() const { return text_; }
+
+private:
+    // Смещения в text_: ключ — как в тексте, без кавычек;
+    // значение — без окружающих пробелов
+    struct Field {
+        uint32_t key_begin = 0;
+        uint32_t key_size = 0;
+        uint32_t value_begin = 0;
+        uint32_t value_size = 0;
+    };
+
+    const std::vector<Field>& GetFields() const;
+
+    std::string_view text_;
+    mutable std::vector<Field> fields_;
+    mutable bool indexed_ = false;
+};
+
+// Документ с корневым словарём, в котором массивы по ключам из lazy_keys
+// не разбираются целиком: их элементы остаются ссылками на исходный текст
+class LazyDocument {
+public:
+    LazyDocument(std::istream& input, const std::vector<std::string>& lazy_keys,
+                 StringPool* pool = nullptr);
+    LazyDocument(const LazyDocument&) = delete;
+    LazyDocument& operator=(const LazyDocument&) = delete;
+
+    const Dict& GetRoot() const { return root_; }
+    const std::vector<RawDict>& GetLazyArray(const std::string& key) const;
+
+private:
+    std::string text_;
+    Dict root_;
+    std::map<std::string, std::vector<RawDict>> lazy_arrays_;
+};
+
+// Читает документ с корневым словарём по частям: значение каждого ключа
+// целиком либо, если это массив, по одному элементу. Элементы можно
+// обрабатывать, не дожидаясь конца документа
+class StreamReader {
+public:
+    explicit StreamReader(std::istream& input, StringPool* pool = nullptr);
+
+    // Следующий ключ корневого словаря, nullopt — словарь закончился
+    std::optional<std::string> NextKey();
+    // Значение текущего ключа целиком
+    Node ReadValue();
+    // Значение текущего ключа — массив: его элементы читаются через NextItem
+    void StartArray();
+    // Следующий элемент массива, nullopt — массив закончился
+    std::optional<Node> NextItem();
+
+private:
+    std::istream& input_;
+    StringPool* pool_;
+};
 
 inline bool operator==(const Document& lhs, const Document& rhs) {
     return lhs.GetRoot() == rhs.GetRoot();
@@ -1,10 +1,14 @@
 #include "json_reader.h"
 #include <algorithm>
+#include <optional>
+#include <unordered_map>
 #include <string>
 #include <iomanip>
 #include <iomanip>
 #include <sstream>
-#include "json_builder.h"
+#include "json_writer.h"
+#include "parallel.h"
+#include "svgz.h"
 
 using namespace std::literals;
 
@@ -86,316 +90,785 @@ RenderSettings ParseRenderSettings(const json::Dict& dict) {
     return settings;
 }
 void JsonReader::LoadData(std::istream& input){
-    json::Document doc = json::Load(input);
+    json::StringPool* pool = settings_.intern_strings ? &string_pool_ : nullptr;
+    if (settings_.lazy_stat_requests) {
+        lazy_document_ = std::make_unique<json::LazyDocument>(input, std::vector{"stat_requests"s}, pool);
+        LoadBaseData(lazy_document_->GetRoot());
+        return;
+    }
+    json::Document doc = pool ? json::Load(input, *pool) : json::Load(input);
     const json::Dict& map = doc.GetRoot().AsMap();
+    LoadBaseData(map);
+    // В режиме сервера базовые данные приходят без stat_requests
+    const auto stat_requests = map.find("stat_requests");
+    if (stat_requests == map.end()) {
+        return;
+    }
+    for(const auto& node : stat_requests->second.AsArray()){
+        const json::Dict& dict = node.AsMap();
+        stats_.push_back(dict);
+    }
+}
+
+void JsonReader::LoadBaseData(const json::Dict& map){
     const json::Array& base_requests = map.at("base_requests").AsArray();
+    // Имена ссылаются на строки документа, который живёт до конца загрузки
     struct DistanceStops{
-        std::string to;
-        std::string from;
+        std::string_view to;
+        std::string_view from;
         int dist;
     };
     std::vector<DistanceStops> road_distances_array;
     road_distances_array.reserve(base_requests.size());
-    for(auto node : base_requests){
+    for(const auto& node : base_requests){
         const json::Dict& dict = node.AsMap();
         if(dict.at("type") == "Stop"){
-            transport_catalogue::Stop stop = ParseStop(dict);
-            catalogue_.AddStop(stop);
-            json::Dict road_distances = dict.at("road_distances").AsMap();
+            catalogue_.AddStop(ParseStop(dict));
+            const std::string& name = dict.at("name").AsString();
+            const json::Dict& road_distances = dict.at("road_distances").AsMap();
             for(const auto& [to, distance] : road_distances){
-                road_distances_array.push_back({stop.name, to, distance.AsInt()});
+                road_distances_array.push_back({name, to.Get(), distance.AsInt()});
             }
         }
     }
     for(const auto& [from, to, distance] : road_distances_array){
         catalogue_.SetDistanceToStops(from, to, distance);
     }
-    for(auto node : base_requests){
-        const json::Dict dict = node.AsMap();
+    for(const auto& node : base_requests){
+        const json::Dict& dict = node.AsMap();
         if(dict.at("type") == "Bus"){
             catalogue_.AddBus(ParseBus(dict));
         }
     }
-    render_settings_ = ParseRenderSettings(map.at("render_settings").AsMap());
-    json::Array stat_requests = map.at("stat_requests").AsArray();
-    for(auto node : stat_requests){
-        const json::Dict& dict = node.AsMap();
-        stats_.push_back(dict);
-    }
+    renderer_ = renderer::MapRenderer(ParseRenderSettings(map.at("render_settings").AsMap()),
+                                      settings_.map_output, settings_.map_detail);
     routing_settings_ = ParseRoutingSettings(map.at("routing_settings").AsMap());
-    router_ = std::make_unique<transport::TransportRouter>(catalogue_, routing_settings_);
+    switch (settings_.router_build) {
+    case RouterBuild::EAGER:
+        GetRouter();
+        break;
+    case RouterBuild::BACKGROUND:
+        // Запросы Bus, Stop и Map выполняются, пока строится граф
+        router_build_ = std::async(std::launch::async, [this] {
+            GetRouter();
+        }).share();
+        break;
+    case RouterBuild::LAZY:
+        break;
+    }
     //catalogue_.SetRouteSettings(ParseRouteSettings(map.at("routing_settings").AsMap()));
 }
 
+JsonReader::RoutingStamp JsonReader::GetRoutingStamp() const {
+    return {catalogue_.GetVersion(), routing_settings_};
+}
+
+std::shared_ptr<const transport::TransportRouter> JsonReader::GetRouter() const {
+    const RoutingStamp stamp = GetRoutingStamp();
+    std::lock_guard guard(router_mutex_);
+    if (!router_ || router_stamp_ != stamp) {
+        // Запросы, уже получившие старый роутер, досчитывают на нём
+        std::atomic_store(&router_, std::shared_ptr<const transport::TransportRouter>(
+            std::make_shared<transport::TransportRouter>(catalogue_, routing_settings_,
+                                                         settings_.router_mode,
+                                                         settings_.tree_cache_bytes)));
+        router_stamp_ = stamp;
+    }
+    return router_;
+}
+
 void JsonReader::RenderMap(std::ostream& output) const {
-    // 1. Собираем все остановки, которые входят в маршруты
-    std::unordered_set<const transport_catalogue::Stop*> stops_in_routes;
-    std::vector<transport_catalogue::Coordinates> stops_coords;
-    // Сначала собираем все автобусы и их остановки
-    for (const auto& [name, bus_ptr] : catalogue_.GetAllBuses()) {
-        for (const auto& stop_name : bus_ptr->route) {
-            const auto* stop = catalogue_.FindStop(stop_name);
-            if (stop && stops_in_routes.insert(stop).second) {
-                stops_coords.emplace_back(stop->coordinates);
-            }
+    renderer_.Render(catalogue_, output);
+}
+
+void PrintNotFound(int id, json::Writer& writer) {
+    writer.StartDict().Key("error_message").Value("not found").Key("request_id").Value(id).EndDict();
+}
+
+void PrintBusInf(int id, const std::optional<request_handler::BusStat>& stat, json::Writer& writer){
+    if (!stat) {
+        PrintNotFound(id, writer);
+        return;
+    }
+    writer.StartDict()
+        .Key("curvature").Value(stat->curvature)
+        .Key("request_id").Value(id)
+        .Key("route_length").Value(stat->route_length)
+        .Key("stop_count").Value(stat->stop_count)
+        .Key("unique_stop_count").Value(stat->unique_stop_count)
+        .EndDict();
+}
+void PrintStopInf(int id, const std::optional<request_handler::StopBuses>& buses, json::Writer& writer) {
+    if (!buses) {
+        PrintNotFound(id, writer);
+        return;
+    }
+    auto buses_array = writer.StartDict().Key("buses").StartArray();
+    for (std::string_view bus : *buses) {
+        buses_array.Value(bus);
+    }
+    buses_array.EndArray().Key("request_id").Value(id).EndDict();
+}
+// Элементы маршрута как JSON-массив
+template <typename Context>
+void PrintRouteItems(const transport::RouteInfo& route_info, Context items_array) {
+    for (const auto& item : route_info.items) {
+        if (std::holds_alternative<transport::WaitItem>(item)) {
+            const auto& wait_item = std::get<transport::WaitItem>(item);
+            items_array.StartDict()
+                .Key("stop_name").Value(wait_item.stop_name)
+                .Key("time").Value(wait_item.time)
+                .Key("type").Value("Wait")
+                .EndDict();
+        } else {
+            const auto& bus_item = std::get<transport::BusItem>(item);
+            items_array.StartDict()
+                .Key("bus").Value(bus_item.bus)
+                .Key("span_count").Value(bus_item.span_count)
+                .Key("time").Value(bus_item.time)
+                .Key("type").Value("Bus")
+                .EndDict();
         }
     }
-    // 2. Инициализируем проектор только с остановками из маршрутов
-    SphereProjector projector(stops_coords.begin(), stops_coords.end(),
-                              render_settings_.width, render_settings_.height,
-                              render_settings_.padding);
+    items_array.EndArray();
+}
 
-    svg::Document doc;
+void PrintRouteInf(int id, const std::optional<transport::RouteInfo>& route_info, json::Writer& writer) {
+    if (!route_info) {
+        PrintNotFound(id, writer);
+        return;
+    }
+    // Ключи пишутся в лексикографическом порядке, как их упорядочивал json::Dict
+    PrintRouteItems(*route_info, writer.StartDict().Key("items").StartArray());
+    writer.Key("request_id").Value(id)
+        .Key("total_time").Value(route_info->total_time)
+        .EndDict();
+}
 
-    // 3. Собираем и сортируем автобусы по имени
-    std::vector<const transport_catalogue::Bus*> buses;
-    for (const auto& [name, bus_ptr] : catalogue_.GetAllBuses()) {
-        buses.emplace_back(bus_ptr);
+void PrintRouteInf(int id, const CachedRoute& cached, json::Writer& writer) {
+    if (!cached.found) {
+        PrintNotFound(id, writer);
+    } else if (cached.route) {
+        PrintRouteInf(id, cached.route, writer);
+    } else {
+        writer.StartDict()
+            .Key("items").RawValue(cached.items_json)
+            .Key("request_id").Value(id)
+            .Key("total_time").RawValue(cached.total_time_json)
+            .EndDict();
     }
-    std::sort(buses.begin(), buses.end(), [](const auto& lhs, const auto& rhs) {
-        return lhs->name < rhs->name;
-    });
+}
 
-    // 4. Рисуем линии маршрутов
-    for (size_t i = 0; i < buses.size(); ++i) {
-        const auto& bus = buses[i];
-        if (bus->route.empty()) continue;
-
-        svg::Polyline polyline;
-        polyline.SetStrokeColor(render_settings_.color_palette[i % render_settings_.color_palette.size()]);
-        polyline.SetStrokeWidth(render_settings_.line_width);
-        polyline.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
-        polyline.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
-        polyline.SetFillColor("none");
-
-        // Добавляем точки для прямого маршрута
-        for (const auto& stop_name : bus->route) {
-            const auto* stop = catalogue_.FindStop(stop_name);
-            if (stop) {
-                polyline.AddPoint(projector(stop->coordinates));
-            }
-        }
-        // Для некольцевого маршрута добавляем обратный путь (кроме последней остановки)
-        if (!bus->is_roundtrip) {
-            for (auto it = bus->route.rbegin() + 1; it != bus->route.rend(); ++it) {
-                const auto* stop = catalogue_.FindStop(*it);
-                if (stop) {
-                    polyline.AddPoint(projector(stop->coordinates));
+std::string RouteCacheKey(std::string_view from, std::string_view to) {
+    std::string key;
+    key.reserve(from.size() + to.size() + 1);
+    key.append(from).push_back('\0');
+    key.append(to);
+    return key;
+}
+
+// Примерный объём ответа в памяти: для бюджета кеша
+size_t EstimateBytes(const std::string& key, const CachedRoute& cached) {
+    size_t bytes = sizeof(CachedRoute) + key.capacity() + cached.items_json.capacity()
+                   + cached.total_time_json.capacity();
+    if (cached.route) {
+        for (const auto& item : cached.route->items) {
+            bytes += sizeof(item) + std::visit([](const auto& value) {
+                if constexpr (std::is_same_v<std::decay_t<decltype(value)>, transport::WaitItem>) {
+                    return value.stop_name.capacity();
+                } else {
+                    return value.bus.capacity();
                 }
-            }
+            }, item);
         }
-        doc.Add(std::move(polyline));
-    }
-    for (size_t i = 0; i < buses.size(); ++i){
-        const auto& bus = buses[i];
-        if (bus->route.empty()) continue;
-        const auto* first_stop = catalogue_.FindStop(bus->route.front());
-        if (first_stop) {
-            svg::Text underlayer;
-            underlayer.SetPosition(projector(first_stop->coordinates));
-            underlayer.SetOffset(render_settings_.bus_label_offset);
-            underlayer.SetFillColor(render_settings_.underlayer_color);
-            underlayer.SetStrokeColor(render_settings_.underlayer_color);
-            underlayer.SetStrokeWidth(render_settings_.underlayer_width);
-            underlayer.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
-            underlayer.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
-            underlayer.SetFontSize(render_settings_.bus_label_font_size);
-            underlayer.SetFontFamily("Verdana");
-            underlayer.SetFontWeight("bold");
-            underlayer.SetData(bus->name);
-            doc.Add(std::move(underlayer));
-
-            // Затем рисуем основной текст
-            svg::Text text;
-            text.SetPosition(projector(first_stop->coordinates));
-            text.SetOffset(render_settings_.bus_label_offset);
-            text.SetFillColor(render_settings_.color_palette[i % render_settings_.color_palette.size()]);
-            text.SetFontSize(render_settings_.bus_label_font_size);
-            text.SetFontFamily("Verdana");
-            text.SetFontWeight("bold");
-            text.SetData(bus->name);
-            doc.Add(std::move(text));
+    }
+    return bytes;
+}
+
+// Строковый литерал JSON с base64 от SVGZ. render(std::ostream&) рисует
+// карту в поток сжатия: её буфер сбрасывается прямо в zlib, а сжатые
+// куски сразу кодируются в строку
+template <typename Render>
+std::string EncodeSvgz(int level, Render render) {
+    std::string json = "\"";
+    svgz::Base64Writer base64(json);
+    {
+        svgz::GzipStream gzip(level, [&base64](std::string_view data) {
+            base64.Write(data);
+        });
+        render(gzip);
+        gzip.Finish();
+    }
+    base64.Finish();
+    json += '"';
+    return json;
+}
+
+std::optional<json::Node> FindField(const json::Dict& request, const std::string& key) {
+    const auto it = request.find(key);
+    if (it == request.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+std::optional<json::Node> FindField(const json::RawDict& request, const std::string& key) {
+    return request.Find(key);
+}
+
+// Область просмотра запроса Map: "viewport" с min_lat, min_lng, max_lat,
+// max_lng либо "center" с lat и lng и необязательный "zoom"
+template <typename Request>
+std::optional<renderer::Viewport> ParseViewport(const Request& request) {
+    renderer::Viewport viewport;
+    if (const auto box = FindField(request, "viewport")) {
+        const json::Dict& dict = box->AsMap();
+        viewport.box = spatial::BoundingBox{dict.at("min_lat").AsDouble(), dict.at("min_lng").AsDouble(),
+                                            dict.at("max_lat").AsDouble(), dict.at("max_lng").AsDouble()};
+        return viewport;
+    }
+    const auto center = FindField(request, "center");
+    if (!center) {
+        return std::nullopt;
+    }
+    viewport.center = {center->AsMap().at("lat").AsDouble(), center->AsMap().at("lng").AsDouble()};
+    if (const auto zoom = FindField(request, "zoom")) {
+        viewport.zoom = zoom->AsDouble();
+    }
+    return viewport;
+}
+
+// Request — json::Dict либо json::RawDict: у второго поля декодируются
+// только здесь, по одному, в момент обращения. Запрос неизвестного типа — nullopt
+template <typename Request>
+std::optional<request_handler::Query> DecodeStatRequest(const Request& request) {
+    const json::Node type = request.at("type");
+    const int id = request.at("id").AsInt();
+    if (type == "Bus") {
+        return request_handler::BusQuery{id, request.at("name").AsString()};
+    } else if (type == "Stop") {
+        return request_handler::StopQuery{id, request.at("name").AsString()};
+    } else if (type == "Route") {
+        return request_handler::RouteQuery{id, request.at("from").AsString(), request.at("to").AsString()};
+    } else if (type == "Map") {
+        return request_handler::MapQuery{id, ParseViewport(request), std::nullopt};
+    } else if (type == "Tile") {
+        // Отрицательные номера станут заведомо неверными: TileId::IsValid их отвергнет
+        return request_handler::MapQuery{id, std::nullopt, renderer::TileId{
+            request.at("z").AsInt(), static_cast<uint32_t>(request.at("x").AsInt()),
+            static_cast<uint32_t>(request.at("y").AsInt())}};
+    }
+    return std::nullopt;
+}
+
+// Одинаковые запросы (с равными key_of) оставляет в distinct по одному разу.
+// Возвращает для каждого запроса индекс его представителя в distinct
+template <typename Hash, typename Query, typename KeyOf>
+std::vector<size_t> Deduplicate(const std::vector<Query>& queries, KeyOf key_of, std::vector<Query>& distinct) {
+    std::unordered_map<std::invoke_result_t<KeyOf, const Query&>, size_t, Hash> index;
+    std::vector<size_t> slots;
+    slots.reserve(queries.size());
+    for (const Query& query : queries) {
+        const auto [it, inserted] = index.emplace(key_of(query), distinct.size());
+        if (inserted) {
+            distinct.push_back(query);
         }
-        if(!bus->is_roundtrip){
-            const auto* last_stop = catalogue_.FindStop(bus->route.back());
-            if (last_stop && last_stop != first_stop) {
-                svg::Text underlayer;
-                underlayer.SetPosition(projector(last_stop->coordinates));
-                underlayer.SetOffset(render_settings_.bus_label_offset);
-                underlayer.SetFillColor(render_settings_.underlayer_color);
-                underlayer.SetStrokeColor(render_settings_.underlayer_color);
-                underlayer.SetStrokeWidth(render_settings_.underlayer_width);
-                underlayer.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
-                underlayer.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
-                underlayer.SetFontSize(render_settings_.bus_label_font_size);
-                underlayer.SetFontFamily("Verdana");
-                underlayer.SetFontWeight("bold");
-                underlayer.SetData(bus->name);
-                doc.Add(std::move(underlayer));
-
-                // Затем рисуем основной текст
-                svg::Text text;
-                text.SetPosition(projector(last_stop->coordinates));
-                text.SetOffset(render_settings_.bus_label_offset);
-                text.SetFillColor(render_settings_.color_palette[i % render_settings_.color_palette.size()]);
-                text.SetFontSize(render_settings_.bus_label_font_size);
-                text.SetFontFamily("Verdana");
-                text.SetFontWeight("bold");
-                text.SetData(bus->name);
-                doc.Add(std::move(text));
-            }
+        slots.push_back(it->second);
+    }
+    return slots;
+}
+
+struct StopPairHasher {
+    size_t operator()(const std::pair<std::string_view, std::string_view>& stops) const {
+        const std::hash<std::string_view> hasher;
+        return hasher(stops.first) * 37 + hasher(stops.second);
+    }
+};
+
+std::shared_ptr<const RenderedMap> JsonReader::GetRenderedMap() const {
+    const uint64_t version = catalogue_.GetVersion();
+    const RenderSettings& settings = renderer_.GetSettings();
+    // Рисуем под блокировкой: параллельные запросы Map дождутся одной отрисовки
+    std::lock_guard guard(map_cache_mutex_);
+    if (map_cache_ && map_cache_->catalogue_version == version && map_cache_->settings == settings) {
+        return map_cache_;
+    }
+    auto rendered = std::make_shared<RenderedMap>();
+    rendered->catalogue_version = version;
+    rendered->settings = settings;
+    if (settings_.map_svgz_level) {
+        rendered->json = EncodeSvgz(*settings_.map_svgz_level, [this](std::ostream& output) {
+            renderer_.Render(catalogue_, map_fragments_, output);
+        });
+    } else {
+        renderer_.Render(catalogue_, map_fragments_, rendered->svg);
+        json::Writer(rendered->json).Value(rendered->svg);
+    }
+    map_cache_ = std::move(rendered);
+    return map_cache_;
+}
+
+void JsonReader::PrinMapInf(int id, json::Writer& writer) const {
+    const auto rendered = GetRenderedMap();
+    writer.StartDict().Key("map").RawValue(rendered->json).Key("request_id").Value(id).EndDict();
+}
+
+std::shared_ptr<const renderer::MapIndex> JsonReader::GetMapIndex() const {
+    const uint64_t version = catalogue_.GetVersion();
+    std::lock_guard guard(map_index_mutex_);
+    if (!map_index_ || map_index_version_ != version) {
+        map_index_ = std::make_shared<renderer::MapIndex>(catalogue_);
+        map_index_version_ = version;
+    }
+    return map_index_;
+}
+
+void JsonReader::PrintMapView(int id, const renderer::Viewport& viewport, json::Writer& writer) const {
+    const auto index = GetMapIndex();
+    const auto area = viewport.Resolve(index->GetBounds());
+    if (settings_.map_svgz_level) {
+        const std::string json = EncodeSvgz(*settings_.map_svgz_level, [&](std::ostream& output) {
+            renderer_.Render(*index, area, output);
+        });
+        writer.StartDict().Key("map").RawValue(json).Key("request_id").Value(id).EndDict();
+        return;
+    }
+    std::string svg;
+    renderer_.Render(*index, area, svg);
+    writer.StartDict().Key("map").Value(svg).Key("request_id").Value(id).EndDict();
+}
+
+void JsonReader::PrintMapTile(int id, renderer::TileId tile, json::Writer& writer) const {
+    if (!tile.IsValid()) {
+        writer.StartDict().Key("error_message").Value("not found").Key("request_id").Value(id).EndDict();
+        return;
+    }
+    const auto index = GetMapIndex();
+    if (settings_.map_svgz_level) {
+        const std::string json = EncodeSvgz(*settings_.map_svgz_level, [&](std::ostream& output) {
+            renderer_.RenderTile(*index, tile, settings_.map_tile_size, output);
+        });
+        writer.StartDict().Key("map").RawValue(json).Key("request_id").Value(id).EndDict();
+        return;
+    }
+    std::string svg;
+    renderer_.RenderTile(*index, tile, settings_.map_tile_size, svg);
+    writer.StartDict().Key("map").Value(svg).Key("request_id").Value(id).EndDict();
+}
+
+tiles::PyramidStats JsonReader::RenderTiles(const tiles::PyramidSettings& settings, tiles::TileSink& sink) const {
+    return tiles::RenderPyramid(renderer_, *GetMapIndex(), settings, sink);
+}
+
+void JsonReader::PrintRouteInf(int id, const std::string& from, const std::string& to, json::Writer& writer) const {
+    json_reader::PrintRouteInf(id, handler_.FindRoute(from, to), writer);
+}
+
+void JsonReader::ProcessRequest(const json::Dict& request, std::string& output) const {
+    json::Writer writer(output, settings_.double_format);
+    ProcessStatRequest(request, writer);
+}
+
+const BatchStats& JsonReader::GetBatchStats() const {
+    return batch_stats_;
+}
+
+std::optional<cache::CacheStats> JsonReader::GetRouteCacheStats() const {
+    if (!route_cache_) {
+        return std::nullopt;
+    }
+    return route_cache_->GetStats();
+}
+
+uint64_t JsonReader::ValidateRouteCache() const {
+    const RoutingStamp stamp = GetRoutingStamp();
+    std::lock_guard guard(route_cache_mutex_);
+    if (route_cache_stamp_ != stamp) {
+        route_cache_->Clear();
+        route_cache_stamp_ = stamp;
+    }
+    // Ответы, посчитанные до следующей очистки, не попадут в кеш после неё
+    return route_cache_->GetGeneration();
+}
+
+std::shared_ptr<const CachedRoute> JsonReader::MakeCachedRoute(
+    const std::optional<transport::RouteInfo>& route) const {
+    auto cached = std::make_shared<CachedRoute>();
+    cached->found = route.has_value();
+    if (!route) {
+        return cached;
+    }
+    if (!settings_.route_cache_json) {
+        cached->route = route;
+        return cached;
+    }
+    {
+        json::Writer items_writer(cached->items_json, settings_.double_format);
+        PrintRouteItems(*route, items_writer.StartArray());
+    }
+    json::AppendNumber(cached->total_time_json, route->total_time, settings_.double_format);
+    return cached;
+}
+
+std::vector<std::shared_ptr<const CachedRoute>> JsonReader::FindCachedRoutes(
+    const std::vector<request_handler::RouteQuery>& routes, size_t thread_count) const {
+    const uint64_t generation = ValidateRouteCache();
+    std::vector<std::shared_ptr<const CachedRoute>> result(routes.size());
+    std::vector<std::string> keys(routes.size());
+    std::vector<request_handler::RouteQuery> missing;
+    std::vector<size_t> missing_positions;
+    for (size_t i = 0; i < routes.size(); ++i) {
+        keys[i] = RouteCacheKey(routes[i].from, routes[i].to);
+        result[i] = route_cache_->Get(keys[i]);
+        if (!result[i]) {
+            missing.push_back(routes[i]);
+            missing_positions.push_back(i);
         }
     }
-    std::vector<const transport_catalogue::Stop*> sorted_stops(stops_in_routes.begin(), stops_in_routes.end());
-    std::sort(sorted_stops.begin(), sorted_stops.end(), [](const auto* lhs, const auto* rhs) {return lhs->name < rhs->name;});
-    for (const auto& stop : sorted_stops){
-        svg::Circle circle;
-        circle.SetCenter(projector(stop->coordinates));
-        circle.SetRadius(render_settings_.stop_radius);
-        circle.SetFillColor("white");
-        doc.Add(std::move(circle));
-    }
-    for (const auto& stop : sorted_stops) {
-        svg::Text underlayer;
-        underlayer.SetPosition(projector(stop->coordinates));
-        underlayer.SetOffset(render_settings_.stop_label_offset);
-        underlayer.SetFillColor(render_settings_.underlayer_color);
-        underlayer.SetStrokeColor(render_settings_.underlayer_color);
-        underlayer.SetStrokeWidth(render_settings_.underlayer_width);
-        underlayer.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
-        underlayer.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
-        underlayer.SetFontSize(render_settings_.stop_label_font_size);
-        underlayer.SetFontFamily("Verdana");
-        underlayer.SetData(stop->name);
-        doc.Add(std::move(underlayer));
-        svg::Text text;
-        text.SetPosition(projector(stop->coordinates));
-        text.SetOffset(render_settings_.stop_label_offset);
-        text.SetFontSize(render_settings_.stop_label_font_size);
-        text.SetFontFamily("Verdana");
-        text.SetData(stop->name);
-        text.SetFillColor("black");
-        doc.Add(std::move(text));
-    }
-    doc.Render(output);
-}
-
-json::Dict PrintBusInf(const json::Dict& dict, transport_catalogue::TransportCatalogue& catalogue){
-    int id  = dict.at("id").AsInt();
-    json::Builder builder;
-    const transport_catalogue::Bus* bus = catalogue.FindBus(dict.at("name").AsString());
-    if (!bus) {
-        return builder.StartDict().Key("request_id").Value(id).Key("error_message").Value("not found").EndDict().Build().AsMap();
-    }
-    transport_catalogue::BusRouteInfo bus_inf = catalogue.GetBusRoute(dict.at("name").AsString());
-    size_t stop_count = bus->is_roundtrip ? bus_inf.stops_on_route : bus_inf.stops_on_route * 2 - 1;
-    return builder.StartDict()
-        .Key("curvature").Value(bus_inf.curvature)
-        .Key("request_id").Value(id)
-        .Key("route_length").Value(bus_inf.fact_length)
-        .Key("stop_count").Value(static_cast<int>(stop_count))
-        .Key("unique_stop_count").Value(static_cast<int>(bus_inf.unique_stops))
-        .EndDict().Build().AsMap();
-}
-json::Dict PrintStopInf(const json::Dict& dict, transport_catalogue::TransportCatalogue& catalogue) {
-    int id = dict.at("id").AsInt();
-    json::Builder builder;
-    const transport_catalogue::Stop* stop = catalogue.FindStop(dict.at("name").AsString());
-    if (!stop) {
-        return builder.StartDict().Key("request_id").Value(id).Key("error_message").Value("not found").EndDict().Build().AsMap();
-    }
-
-    const auto& buses = catalogue.GetBusesByStop(dict.at("name").AsString());
-    std::vector<std::string> buses_vector(buses.begin(), buses.end());
-    std::sort(buses_vector.begin(), buses_vector.end());
-
-    json::Array buses_array;
-    buses_array.reserve(buses_vector.size());
-    for (const auto& bus : buses_vector) {
-        buses_array.emplace_back(bus);
-    }
-    return builder.StartDict().Key("request_id").Value(id).Key("buses").Value(std::move(buses_array)).EndDict().Build().AsMap();
-}
-json::Dict JsonReader::PrinMapInf(const json::Dict& dict){
-    int id = dict.at("id").AsInt();
-    json::Builder builder;
-    std::ostringstream map_stream;
-    this->JsonReader::RenderMap(map_stream);
-    std::string svg_content = map_stream.str();
-    return builder.StartDict().Key("map").Value(std::move(svg_content)).Key("request_id").Value(id).EndDict().Build().AsMap();
-}
-
-// Обновить функцию PrintRouteInf
-json::Dict JsonReader::PrintRouteInf(const json::Dict& dict) {
-    int id = dict.at("id").AsInt();
-    std::string from = dict.at("from").AsString();
-    std::string to = dict.at("to").AsString();
-    auto route_info = router_->FindRoute(from, to);
-    if (!route_info) {
-        return json::Builder{}
-            .StartDict()
-            .Key("request_id").Value(id)
-            .Key("error_message").Value("not found")
-            .EndDict()
-            .Build()
-            .AsMap();
+    const auto found = handler_.FindRoutes(ranges::AsSpan(missing), thread_count);
+    for (size_t i = 0; i < found.size(); ++i) {
+        const size_t position = missing_positions[i];
+        result[position] = MakeCachedRoute(found[i]);
+        route_cache_->Put(keys[position], result[position], EstimateBytes(keys[position], *result[position]),
+                          generation);
     }
+    return result;
+}
 
-    // Создаем массив items
-    json::Array items_array;
-    for (const auto& item : route_info->items) {
-        if (std::holds_alternative<transport::WaitItem>(item)) {
-            const auto& wait_item = std::get<transport::WaitItem>(item);
-            items_array.push_back(
-                json::Builder{}
-                    .StartDict()
-                    .Key("type").Value("Wait")
-                    .Key("stop_name").Value(wait_item.stop_name)
-                    .Key("time").Value(wait_item.time)
-                    .EndDict()
-                    .Build()
-                    .AsMap()
-                );
+std::optional<cache::CacheStats> JsonReader::GetTreeCacheStats() const {
+    // Не ждёт router_mutex_: пока роутер строится в фоне, статистики нет
+    const auto router = std::atomic_load(&router_);
+    if (!router) {
+        return std::nullopt;
+    }
+    return router->GetTreeCacheStats();
+}
+
+template <typename Request>
+void JsonReader::ProcessStatRequest(const Request& request, json::Writer& writer) const {
+    const auto query = DecodeStatRequest(request);
+    if (!query) {
+        return;
+    }
+    std::visit([this, &writer](const auto& item) {
+        using T = std::decay_t<decltype(item)>;
+        if constexpr (std::is_same_v<T, request_handler::BusQuery>) {
+            PrintBusInf(item.id, handler_.GetBusStat(item.name), writer);
+        } else if constexpr (std::is_same_v<T, request_handler::StopQuery>) {
+            PrintStopInf(item.id, handler_.GetBusesByStop(item.name), writer);
+        } else if constexpr (std::is_same_v<T, request_handler::RouteQuery>) {
+            if (route_cache_) {
+                const auto cached = FindCachedRoutes({item}, 1);
+                json_reader::PrintRouteInf(item.id, *cached.front(), writer);
+            } else {
+                json_reader::PrintRouteInf(item.id, handler_.FindRoute(item.from, item.to), writer);
+            }
+        } else if (item.tile) {
+            PrintMapTile(item.id, *item.tile, writer);
+        } else if (item.viewport) {
+            PrintMapView(item.id, *item.viewport, writer);
         } else {
-            const auto& bus_item = std::get<transport::BusItem>(item);
-            items_array.push_back(
-                json::Builder{}
-                    .StartDict()
-                    .Key("type").Value("Bus")
-                    .Key("bus").Value(bus_item.bus)
-                    .Key("span_count").Value(bus_item.span_count)
-                    .Key("time").Value(bus_item.time)
-                    .EndDict()
-                    .Build()
-                    .AsMap()
-                );
+            PrinMapInf(item.id, writer);
         }
+    }, *query);
+}
+
+// Запросы только читают каталог и роутер, поэтому в параллельном режиме
+// выполняются одновременно: каждый ответ пишется в свою строку,
+// а в output они уходят строго в порядке запросов.
+// Иначе запросы декодируются пачками и выполняются по типам (ExecuteBatch),
+// а при объединении одинаковых запросов пачка — весь пакет
+template <typename Request>
+BatchStats JsonReader::ProcessStatRequests(const std::vector<Request>& requests, json::Writer& writer) const {
+    if (settings_.parallel_stat_requests && !settings_.coalesce_requests) {
+        const size_t thread_count = settings_.thread_count > 0 ? settings_.thread_count
+                                                                : parallel::DefaultThreadCount();
+        parallel::OrderedForEach<std::string>(requests.size(), thread_count,
+            [this, &requests](size_t i) {
+                std::string response;
+                json::Writer response_writer(response, settings_.double_format);
+                ProcessStatRequest(requests[i], response_writer);
+                return response;
+            },
+            [&writer](size_t, std::string&& response) {
+                // Запрос неизвестного типа не даёт ответа
+                if (!response.empty()) {
+                    writer.RawValue(response);
+                }
+            });
+        BatchStats stats;
+        stats.request_count = stats.distinct_count = requests.size();
+        return stats;
     }
 
-    return json::Builder{}
-        .StartDict()
-        .Key("request_id").Value(id)
-        .Key("total_time").Value(route_info->total_time)
-        .Key("items").Value(std::move(items_array))
-        .EndDict()
-        .Build()
-        .AsMap();
+    constexpr size_t BATCH_SIZE = 4096;
+    const size_t batch_size = settings_.coalesce_requests ? requests.size() : BATCH_SIZE;
+    BatchStats stats;
+    for (size_t start = 0; start < requests.size(); start += batch_size) {
+        const size_t end = std::min(requests.size(), start + batch_size);
+        request_handler::QueryBatch batch;
+        batch.order.reserve(end - start);
+        for (size_t i = start; i < end; ++i) {
+            if (auto query = DecodeStatRequest(requests[i])) {
+                batch.Add(std::move(*query));
+            }
+        }
+        const BatchStats batch_stats = ExecuteBatch(batch, writer);
+        stats.request_count += end - start;
+        stats.distinct_count += batch_stats.distinct_count;
+        stats.route_origin_count += batch_stats.route_origin_count;
+    }
+    return stats;
 }
+
+// При объединении одинаковые запросы (Bus и Stop по имени, Route по паре
+// остановок) выполняются один раз, и ответ выводится для каждого их id.
+// Маршруты с общей начальной остановкой RequestHandler считает вместе
+BatchStats JsonReader::ExecuteBatch(const request_handler::QueryBatch& batch, json::Writer& writer) const {
+    using namespace request_handler;
+    const bool coalesce = settings_.coalesce_requests;
+    std::vector<BusQuery> distinct_buses;
+    std::vector<StopQuery> distinct_stops;
+    std::vector<RouteQuery> distinct_routes;
+    std::vector<size_t> bus_slots;
+    std::vector<size_t> stop_slots;
+    std::vector<size_t> route_slots;
+    if (coalesce) {
+        bus_slots = Deduplicate<std::hash<std::string_view>>(batch.buses, [](const BusQuery& query) {
+            return std::string_view(query.name);
+        }, distinct_buses);
+        stop_slots = Deduplicate<std::hash<std::string_view>>(batch.stops, [](const StopQuery& query) {
+            return std::string_view(query.name);
+        }, distinct_stops);
+        route_slots = Deduplicate<StopPairHasher>(batch.routes, [](const RouteQuery& query) {
+            return std::pair<std::string_view, std::string_view>(query.from, query.to);
+        }, distinct_routes);
+    }
+    const auto& buses = coalesce ? distinct_buses : batch.buses;
+    const auto& stops = coalesce ? distinct_stops : batch.stops;
+    const auto& routes = coalesce ? distinct_routes : batch.routes;
+    auto slot = [](const std::vector<size_t>& slots, size_t index) {
+        return slots.empty() ? index : slots[index];
+    };
+
+    const size_t thread_count = !settings_.parallel_stat_requests ? 1
+                              : settings_.thread_count > 0 ? settings_.thread_count
+                                                           : parallel::DefaultThreadCount();
+    const auto bus_stats = handler_.GetBusStats(ranges::AsSpan(buses));
+    const auto stop_buses = handler_.GetBusesByStops(ranges::AsSpan(stops));
+    // С кешем маршруты берутся из него, без кеша — считаются все
+    const auto cached_routes = route_cache_ ? FindCachedRoutes(routes, thread_count)
+                                            : std::vector<std::shared_ptr<const CachedRoute>>{};
+    const auto found_routes = route_cache_ ? std::vector<std::optional<transport::RouteInfo>>{}
+                                           : handler_.FindRoutes(ranges::AsSpan(routes), thread_count);
+    const bool full_map = std::any_of(batch.maps.begin(), batch.maps.end(), [](const auto& query) {
+        return !query.viewport && !query.tile;
+    });
+    const auto rendered = full_map ? GetRenderedMap() : nullptr;
+
+    for (const auto& [type, index] : batch.order) {
+        switch (type) {
+        case QueryType::BUS:
+            PrintBusInf(batch.buses[index].id, bus_stats[slot(bus_slots, index)], writer);
+            break;
+        case QueryType::STOP:
+            PrintStopInf(batch.stops[index].id, stop_buses[slot(stop_slots, index)], writer);
+            break;
+        case QueryType::ROUTE:
+            if (route_cache_) {
+                json_reader::PrintRouteInf(batch.routes[index].id, *cached_routes[slot(route_slots, index)], writer);
+            } else {
+                json_reader::PrintRouteInf(batch.routes[index].id, found_routes[slot(route_slots, index)], writer);
+            }
+            break;
+        case QueryType::MAP:
+            if (const auto& tile = batch.maps[index].tile) {
+                PrintMapTile(batch.maps[index].id, *tile, writer);
+            } else if (const auto& viewport = batch.maps[index].viewport) {
+                PrintMapView(batch.maps[index].id, *viewport, writer);
+            } else {
+                writer.StartDict().Key("map").RawValue(rendered->json)
+                    .Key("request_id").Value(batch.maps[index].id).EndDict();
+            }
+            break;
+        }
+    }
+
+    BatchStats stats;
+    stats.request_count = batch.size();
+    stats.distinct_count = buses.size() + stops.size() + routes.size()
+                           + (coalesce ? std::min<size_t>(batch.maps.size(), 1) : batch.maps.size());
+    stats.route_origin_count = RequestHandler::CountOrigins(ranges::AsSpan(routes));
+    return stats;
+}
+
+template <typename Request>
+BatchStats JsonReader::WriteResponses(const std::vector<Request>& requests, std::ostream& output) const {
+    // Ответы уходят в output по мере заполнения буфера writer-а
+    json::Writer writer(output, settings_.double_format);
+    writer.StartArray();
+    BatchStats stats = ProcessStatRequests(requests, writer);
+    writer.EndArray();
+    writer.Finish();
+    return stats;
+}
+
 void JsonReader::ProcessRequests(std::ostream& output) {
-    json::Array print_stats;
-    for(auto node : stats_){
-        const json::Dict& dict = node;
-        if(dict.at("type") == "Bus"){
-            print_stats.push_back(PrintBusInf(dict, catalogue_));
-        }else if(dict.at("type") == "Stop"){
-            print_stats.push_back(PrintStopInf(dict, catalogue_));
-        }else if(dict.at("type") == "Map"){
-            print_stats.push_back(this->PrinMapInf(dict));
+    if (lazy_document_) {
+        batch_stats_ = WriteResponses(lazy_document_->GetLazyArray("stat_requests"), output);
+    } else {
+        batch_stats_ = WriteResponses(stats_, output);
+    }
+}
+
+BatchStats JsonReader::ProcessBatch(std::istream& input, std::ostream& output) const {
+    // Пул строк общий для всего ридера и не защищён блокировкой,
+    // поэтому пакеты разбираются без интернирования
+    const json::Document doc = json::Load(input);
+    const json::Node& root = doc.GetRoot();
+    const json::Array& requests = root.IsArray() ? root.AsArray()
+                                                 : root.AsMap().at("stat_requests").AsArray();
+    std::vector<json::Dict> dicts;
+    dicts.reserve(requests.size());
+    for (const auto& node : requests) {
+        dicts.push_back(node.AsMap());
+    }
+    return WriteResponses(dicts, output);
+}
+
+void JsonReader::ProcessStream(std::istream& input, std::ostream& output) {
+    json::StringPool* pool = settings_.intern_strings ? &string_pool_ : nullptr;
+    json::StreamReader reader(input, pool);
+    json::Dict root;
+    bool processed = false;
+    while (auto key = reader.NextKey()) {
+        const bool base_loaded = root.count("base_requests") && root.count("render_settings")
+                                 && root.count("routing_settings");
+        if (*key != "stat_requests" || !base_loaded) {
+            root.emplace(std::move(*key), reader.ReadValue());
+            continue;
+        }
+        LoadBaseData(root);
+        reader.StartArray();
+        batch_stats_ = PipelineStatRequests(reader, output);
+        processed = true;
+    }
+    if (processed) {
+        return;
+    }
+    LoadBaseData(root);
+    if (const auto stat_requests = root.find("stat_requests"); stat_requests != root.end()) {
+        for (const auto& node : stat_requests->second.AsArray()) {
+            stats_.push_back(node.AsMap());
+        }
+    }
+    ProcessRequests(output);
+}
+
+// Три стадии: вызывающий поток читает запросы, пул потоков их выполняет,
+// отдельный поток выводит ответы по порядку. Между стадиями запросы
+// передаются пачками по PIPELINE_CHUNK, чтобы синхронизация не стоила
+// дороже самих запросов. Пачка отдаётся на выполнение, только когда для
+// её ответа есть место в окне responses: от отправки до вывода в обороте
+// не больше depth пачек (в очереди, у рабочих потоков и среди готовых
+// ответов вместе). Объединение одинаковых запросов здесь
+// не применяется: для него нужен весь пакет сразу
+BatchStats JsonReader::PipelineStatRequests(json::StreamReader& reader, std::ostream& output) const {
+    constexpr size_t PIPELINE_CHUNK = 64;
+    const size_t thread_count = settings_.thread_count > 0 ? settings_.thread_count
+                                                            : parallel::DefaultThreadCount();
+    const size_t depth = std::max<size_t>(1, settings_.pipeline_depth / PIPELINE_CHUNK);
+    parallel::BoundedQueue<std::pair<size_t, std::vector<json::Node>>> requests(depth);
+    // Ответы пачки через запятую, готовые для вставки в массив
+    parallel::ReorderBuffer<std::string> responses(depth);
+    std::mutex error_mutex;
+    std::exception_ptr error;
+    auto fail = [&](std::exception_ptr e) {
+        {
+            std::lock_guard guard(error_mutex);
+            if (!error) {
+                error = e;
+            }
+        }
+        responses.Fail(e);
+        requests.Close();
+    };
+
+    BatchStats stats;
+    {
+        parallel::ThreadGroup threads;
+        for (size_t t = 0; t < thread_count; ++t) {
+            threads.Start([&] {
+                while (auto chunk = requests.Pop()) {
+                    try {
+                        std::string response;
+                        for (const json::Node& request : chunk->second) {
+                            const size_t size = response.size();
+                            if (size > 0) {
+                                response.push_back(',');
+                            }
+                            const size_t start = response.size();
+                            json::Writer response_writer(response, settings_.double_format);
+                            ProcessStatRequest(request.AsMap(), response_writer);
+                            // Запрос неизвестного типа не даёт ответа
+                            if (response.size() == start) {
+                                response.resize(size);
+                            }
+                        }
+                        responses.Put(chunk->first, std::move(response));
+                    } catch (...) {
+                        fail(std::current_exception());
+                    }
+                }
+            });
         }
-        else if(dict.at("type") == "Route"){
-            print_stats.push_back(PrintRouteInf(dict));
+        threads.Start([&] {
+            try {
+                json::Writer writer(output, settings_.double_format);
+                writer.StartArray();
+                while (auto response = responses.Take()) {
+                    if (!response->empty()) {
+                        writer.RawValue(*response);
+                    }
+                }
+                writer.EndArray();
+                writer.Finish();
+            } catch (...) {
+                fail(std::current_exception());
+            }
+        });
+
+        try {
+            size_t count = 0;
+            size_t chunk_count = 0;
+            std::vector<json::Node> chunk;
+            auto push_chunk = [&] {
+                const bool pushed = responses.WaitForSlot(chunk_count)
+                                    && requests.Push({chunk_count, std::move(chunk)});
+                chunk_count += pushed ? 1 : 0;
+                chunk = {};
+                return pushed;
+            };
+            while (auto node = reader.NextItem()) {
+                chunk.push_back(std::move(*node));
+                ++count;
+                if (chunk.size() == PIPELINE_CHUNK && !push_chunk()) {
+                    break;
+                }
+            }
+            if (!chunk.empty()) {
+                push_chunk();
+            }
+            stats.request_count = stats.distinct_count = count;
+            responses.SetCount(chunk_count);
+        } catch (...) {
+            fail(std::current_exception());
         }
+        requests.Close();
+    }
+    if (error) {
+        std::rethrow_exception(error);
     }
-    json::Print(json::Document{std::move(print_stats)}, output);
+    return stats;
 }
 }
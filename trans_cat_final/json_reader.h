@@ -1,10 +1,20 @@
 #pragma once
 #include "transport_catalogue.h"
 #include "json.h"
+#include "json_writer.h"
+#include "lru_cache.h"
 #include <iostream>
 #include <vector>
 #include <cstddef>
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
 #include "map_renderer.h"
+#include "request_handler.h"
+#include "tile_pyramid.h"
 #include "transport_router.h"
 
 
@@ -14,33 +24,188 @@
  */
 
 namespace json_reader{
-struct RenderSettings {
-    double width = 0;
-    double height = 0;
-    double padding = 0;
-    double line_width = 0;
-    double stop_radius = 0;
-    int bus_label_font_size = 0;
-    svg::Point bus_label_offset;
-    int stop_label_font_size = 0;
-    svg::Point stop_label_offset;
-    svg::Color underlayer_color;
-    double underlayer_width = 0;
-    std::vector<svg::Color> color_palette;
+using renderer::RenderSettings;
+
+// Готовая карта: SVG и он же в виде строкового литерала JSON. Со сжатием
+// (ReaderSettings::map_svgz_level) svg пуст, а в json — base64 от SVGZ
+struct RenderedMap {
+    uint64_t catalogue_version = 0;
+    RenderSettings settings;
+    std::string svg;
+    std::string json;
+};
+
+// Когда строится роутер
+enum class RouterBuild {
+    EAGER,       // сразу при загрузке данных
+    LAZY,        // при первом запросе Route
+    BACKGROUND,  // в отдельном потоке сразу после загрузки данных
+};
+
+struct ReaderSettings {
+    // stat_requests не разбираются при загрузке: поля каждого запроса
+    // декодируются из исходного текста в момент обработки
+    bool lazy_stat_requests = false;
+    // Повторяющиеся строки входного документа хранятся в одном экземпляре
+    bool intern_strings = false;
+    // stat_requests выполняются пулом из thread_count потоков
+    // (0 — по числу ядер), ответы выводятся в исходном порядке
+    bool parallel_stat_requests = false;
+    size_t thread_count = 0;
+    // Формат дробных чисел в ответах
+    json::DoubleFormat double_format = json::DoubleFormat::STREAM;
+    // Одинаковые запросы пакета выполняются один раз, маршруты
+    // с общей начальной остановкой считаются вместе
+    bool coalesce_requests = false;
+    transport::RouterMode router_mode = transport::RouterMode::ALL_PAIRS;
+    RouterBuild router_build = RouterBuild::LAZY;
+    // Бюджет кеша деревьев кратчайших путей (режим SINGLE_SOURCE), 0 — без кеша
+    size_t tree_cache_bytes = 0;
+    // Бюджет кеша ответов на запросы Route, 0 — без кеша. Ответ хранится
+    // уже сериализованным в JSON либо, если route_cache_json == false,
+    // в виде transport::RouteInfo
+    size_t route_cache_bytes = 0;
+    bool route_cache_json = true;
+    renderer::OutputOptions map_output;
+    renderer::DetailSettings map_detail;
+    // Карта в ответах Map — строка base64 от SVGZ (gzip с этим уровнем,
+    // 0..9) вместо текста SVG. Отрисовка, сжатие и кодирование идут
+    // одним проходом, без полного SVG в памяти и без экранирования JSON
+    std::optional<int> map_svgz_level;
+    // Сторона плитки в ответах Tile
+    double map_tile_size = 256;
+    // ProcessStream: разбор, выполнение и вывод stat_requests идут
+    // одновременно. Прочитанных, но ещё не выведенных запросов не больше
+    // pipeline_depth (округлённо до пачки из 64) и ещё по пачке у чтения и вывода
+    size_t pipeline_depth = 1024;
+};
+
+// Результат планирования пакета stat_requests
+struct BatchStats {
+    size_t request_count = 0;
+    // Сколько запросов выполнено на самом деле (без повторов)
+    size_t distinct_count = 0;
+    // Сколько разных начальных остановок у запросов Route
+    size_t route_origin_count = 0;
 };
+
+// Ответ на запрос Route без request_id. В режиме JSON маршрут хранится
+// готовыми фрагментами items_json и total_time_json, иначе — в route
+struct CachedRoute {
+    bool found = false;
+    std::optional<transport::RouteInfo> route;
+    std::string items_json;
+    std::string total_time_json;
+};
+
 class JsonReader{
 public:
-    JsonReader(transport_catalogue::TransportCatalogue& catalogue): catalogue_(catalogue){}
+    JsonReader(transport_catalogue::TransportCatalogue& catalogue, ReaderSettings settings = {})
+        : catalogue_(catalogue), settings_(settings)
+        , handler_(catalogue_, renderer_, [this] {
+            return GetRouter();
+        })
+        , route_cache_(settings.route_cache_bytes > 0
+                       ? std::make_unique<RouteCache>(settings.route_cache_bytes) : nullptr) {}
     void LoadData(std::istream& input);
     void ProcessRequests(std::ostream& output);
+    // LoadData и ProcessRequests конвейером: если базовые данные в документе
+    // идут раньше stat_requests, запросы выполняются по мере чтения, а ответы
+    // выводятся, не дожидаясь конца входа. Иначе — как LoadData + ProcessRequests
+    void ProcessStream(std::istream& input, std::ostream& output);
+    // Отвечает на пакет {"stat_requests": [...]} (или просто массив запросов)
+    // по уже загруженным данным. Общее состояние только читается, поэтому
+    // пакеты разных клиентов можно обрабатывать одновременно
+    BatchStats ProcessBatch(std::istream& input, std::ostream& output) const;
+    // Дописывает в output ответ на один запрос; на запрос неизвестного
+    // типа ничего не пишется
+    void ProcessRequest(const json::Dict& request, std::string& output) const;
     void RenderMap(std::ostream& output) const;
-    json::Dict PrinMapInf(const json::Dict& dict);
-    json::Dict PrintRouteInf(const json::Dict& dict);
+    // Карта рисуется один раз и перерисовывается только после изменения
+    // каталога или настроек отрисовки
+    std::shared_ptr<const RenderedMap> GetRenderedMap() const;
+    void PrinMapInf(int id, json::Writer& writer) const;
+    // Карта только той части сети, что видна в области просмотра. Такие
+    // карты не кешируются, но рисуются по индексу, построенному один раз
+    void PrintMapView(int id, const renderer::Viewport& viewport, json::Writer& writer) const;
+    // Плитка z/x/y пирамиды карты, как в tiles::RenderPyramid
+    void PrintMapTile(int id, renderer::TileId tile, json::Writer& writer) const;
+    // Рисует пирамиду плиток по уже загруженным данным и пишет её в sink
+    tiles::PyramidStats RenderTiles(const tiles::PyramidSettings& settings, tiles::TileSink& sink) const;
+    void PrintRouteInf(int id, const std::string& from, const std::string& to, json::Writer& writer) const;
+    // Статистика последнего вызова ProcessRequests
+    const BatchStats& GetBatchStats() const;
+    // Статистика кеша деревьев; nullopt, если роутер ещё не построен или кеша нет
+    std::optional<cache::CacheStats> GetTreeCacheStats() const;
+    // Статистика кеша ответов Route; nullopt, если кеша нет
+    std::optional<cache::CacheStats> GetRouteCacheStats() const;
 private:
+    // Ключ — названия остановок from и to через '\0'
+    using RouteCache = cache::ShardedLruCache<std::string, CachedRoute>;
+
+    void LoadBaseData(const json::Dict& map);
+    std::shared_ptr<const renderer::MapIndex> GetMapIndex() const;
+    // Каталог и настройки маршрутов, по которым построены роутер и кеш Route
+    struct RoutingStamp {
+        uint64_t catalogue_version = 0;
+        transport::RoutingSettings settings;
+
+        bool operator==(const RoutingStamp& other) const {
+            return catalogue_version == other.catalogue_version && settings == other.settings;
+        }
+        bool operator!=(const RoutingStamp& other) const {
+            return !(*this == other);
+        }
+    };
+
+    RoutingStamp GetRoutingStamp() const;
+    // Роутер для текущей версии каталога: построенный заново после изменения
+    // каталога или настроек, либо дождавшийся фоновой сборки
+    std::shared_ptr<const transport::TransportRouter> GetRouter() const;
+    template <typename Request>
+    void ProcessStatRequest(const Request& request, json::Writer& writer) const;
+    template <typename Request>
+    BatchStats ProcessStatRequests(const std::vector<Request>& requests, json::Writer& writer) const;
+    template <typename Request>
+    BatchStats WriteResponses(const std::vector<Request>& requests, std::ostream& output) const;
+    BatchStats PipelineStatRequests(json::StreamReader& reader, std::ostream& output) const;
+    // Сбрасывает кеш ответов Route, если каталог или настройки маршрутов
+    // изменились. Возвращает поколение кеша для RouteCache::Put
+    uint64_t ValidateRouteCache() const;
+    std::shared_ptr<const CachedRoute> MakeCachedRoute(const std::optional<transport::RouteInfo>& route) const;
+    // Ответы Route через кеш: посчитаны только те, которых в кеше не было
+    std::vector<std::shared_ptr<const CachedRoute>> FindCachedRoutes(
+        const std::vector<request_handler::RouteQuery>& routes, size_t thread_count) const;
+    // Выполняет пакет по типам запросов и выводит ответы в исходном порядке
+    BatchStats ExecuteBatch(const request_handler::QueryBatch& batch, json::Writer& writer) const;
+
     transport_catalogue::TransportCatalogue& catalogue_;
-    RenderSettings render_settings_;
+    ReaderSettings settings_;
+    renderer::MapRenderer renderer_;
+    request_handler::RequestHandler handler_;
     std::vector<json::Dict> stats_;
+    json::StringPool string_pool_;
+    std::unique_ptr<json::LazyDocument> lazy_document_;
     transport::RoutingSettings routing_settings_;
-    std::unique_ptr<transport::TransportRouter> router_;
+    // Сборка и замена роутера идут под router_mutex_; router_ пишется
+    // и читается без блокировки через std::atomic_store/atomic_load
+    mutable std::mutex router_mutex_;
+    mutable std::shared_ptr<const transport::TransportRouter> router_;
+    mutable RoutingStamp router_stamp_;
+    // Объявлен после router_: деструктор дожидается фоновой сборки
+    // раньше, чем будут разрушены роутер и его настройки
+    std::shared_future<void> router_build_;
+    mutable std::mutex map_cache_mutex_;
+    mutable std::shared_ptr<const RenderedMap> map_cache_;
+    // Фрагменты карты для перерисовки после изменения каталога; под map_cache_mutex_
+    mutable renderer::MapCache map_fragments_;
+    mutable std::mutex map_index_mutex_;
+    mutable std::shared_ptr<const renderer::MapIndex> map_index_;
+    mutable uint64_t map_index_version_ = 0;
+    BatchStats batch_stats_;
+    std::unique_ptr<RouteCache> route_cache_;
+    // Для чего заполнен кеш ответов Route; под route_cache_mutex_
+    mutable std::mutex route_cache_mutex_;
+    mutable std::optional<RoutingStamp> route_cache_stamp_;
 };
 }
@@ -0,0 +1,235 @@
+#include "json_writer.h"
+#include "escape.h"
+
+namespace json {
+
+using namespace std::literals;
+
+Writer::Writer(std::ostream& output, DoubleFormat double_format, size_t flush_threshold)
+    : output_(&output)
+    , double_format_(double_format)
+    , flush_threshold_(flush_threshold)
+    , buffer_(own_buffer_) {
+    buffer_.reserve(flush_threshold_ + flush_threshold_ / 4);
+}
+
+Writer::Writer(std::string& output, DoubleFormat double_format)
+    : double_format_(double_format)
+    , buffer_(output) {
+}
+
+Writer::~Writer() {
+    Flush();
+}
+
+void Writer::Finish() {
+    if (!scopes_.empty() || !root_written_) {
+        throw std::logic_error("JSON is not complete");
+    }
+    Flush();
+}
+
+void Writer::BeforeValue() {
+    if (scopes_.empty()) {
+        if (root_written_) {
+            throw std::logic_error("Multiple root values");
+        }
+        root_written_ = true;
+        return;
+    }
+    Scope& scope = scopes_.back();
+    if (scope.is_dict) {
+        if (!key_expected_) {
+            throw std::logic_error("Value without key in dictionary");
+        }
+        key_expected_ = false;
+        return;
+    }
+    if (!scope.empty) {
+        buffer_.push_back(',');
+    }
+    scope.empty = false;
+}
+
+Writer::DictItemContext Writer::StartDict() {
+    BeforeValue();
+    buffer_.push_back('{');
+    scopes_.push_back({true, true});
+    return DictItemContext(*this);
+}
+
+Writer::ArrayItemContext Writer::StartArray() {
+    BeforeValue();
+    buffer_.push_back('[');
+    scopes_.push_back({false, true});
+    return ArrayItemContext(*this);
+}
+
+Writer::DictValueContext Writer::Key(std::string_view key) {
+    if (scopes_.empty() || !scopes_.back().is_dict) {
+        throw std::logic_error("Key outside of dictionary");
+    }
+    if (key_expected_) {
+        throw std::logic_error("Key already set");
+    }
+    Scope& scope = scopes_.back();
+    if (!scope.empty) {
+        buffer_.push_back(',');
+    }
+    scope.empty = false;
+    WriteString(key);
+    buffer_.push_back(':');
+    key_expected_ = true;
+    return DictValueContext(*this);
+}
+
+Writer& Writer::EndDict() {
+    if (scopes_.empty() || !scopes_.back().is_dict) {
+        throw std::logic_error("EndDict without StartDict");
+    }
+    if (key_expected_) {
+        throw std::logic_error("Unfinished key-value pair");
+    }
+    scopes_.pop_back();
+    buffer_.push_back('}');
+    FlushIfFull();
+    return *this;
+}
+
+Writer& Writer::EndArray() {
+    if (scopes_.empty() || scopes_.back().is_dict) {
+        throw std::logic_error("EndArray without StartArray");
+    }
+    scopes_.pop_back();
+    buffer_.push_back(']');
+    FlushIfFull();
+    return *this;
+}
+
+Writer& Writer::Value(std::nullptr_t) {
+    BeforeValue();
+    buffer_ += "null"sv;
+    return *this;
+}
+
+Writer& Writer::Value(bool value) {
+    BeforeValue();
+    buffer_ += value ? "true"sv : "false"sv;
+    return *this;
+}
+
+Writer& Writer::Value(int value) {
+    BeforeValue();
+    AppendNumber(buffer_, value);
+    return *this;
+}
+
+Writer& Writer::Value(double value) {
+    BeforeValue();
+    AppendNumber(buffer_, value, double_format_);
+    return *this;
+}
+
+Writer& Writer::Value(std::string_view value) {
+    BeforeValue();
+    WriteString(value);
+    FlushIfFull();
+    return *this;
+}
+
+Writer& Writer::Value(const std::string& value) {
+    return Value(std::string_view(value));
+}
+
+Writer& Writer::Value(const char* value) {
+    return Value(std::string_view(value));
+}
+
+Writer& Writer::RawValue(std::string_view json) {
+    BeforeValue();
+    buffer_ += json;
+    FlushIfFull();
+    return *this;
+}
+
+Writer& Writer::Value(const Node& value) {
+    std::visit([this](const auto& item) {
+        using T = std::decay_t<decltype(item)>;
+        if constexpr (std::is_same_v<T, Array>) {
+            StartArray();
+            for (const Node& element : item) {
+                Value(element);
+            }
+            EndArray();
+        } else if constexpr (std::is_same_v<T, Dict>) {
+            StartDict();
+            for (const auto& [key, element] : item) {
+                Key(key.Get());
+                Value(element);
+            }
+            EndDict();
+        } else if constexpr (std::is_same_v<T, InternedString>) {
+            Value(*item.value);
+        } else {
+            Value(item);
+        }
+    }, value.GetValue());
+    return *this;
+}
+
+void Writer::WriteString(std::string_view value) {
+    buffer_.push_back('"');
+    escape::Json().Append(buffer_, value);
+    buffer_.push_back('"');
+}
+
+void Writer::FlushIfFull() {
+    if (output_ && buffer_.size() >= flush_threshold_) {
+        Flush();
+    }
+}
+
+void Writer::Flush() {
+    if (output_) {
+        output_->write(buffer_.data(), buffer_.size());
+        buffer_.clear();
+    }
+}
+
+Writer::DictValueContext Writer::DictItemContext::Key(std::string_view key) {
+    return writer_.Key(key);
+}
+
+Writer& Writer::DictItemContext::EndDict() {
+    return writer_.EndDict();
+}
+
+Writer::DictItemContext Writer::BaseContext::StartDict() {
+    return writer_.StartDict();
+}
+
+Writer::ArrayItemContext Writer::BaseContext::StartArray() {
+    return writer_.StartArray();
+}
+
+void Writer::BaseContext::Finish() {
+    writer_.Finish();
+}
+
+Writer::DictValueContext Writer::BaseContext::Key(std::string_view key) {
+    return writer_.Key(key);
+}
+
+Writer& Writer::BaseContext::RawValue(std::string_view json) {
+    return writer_.RawValue(json);
+}
+
+Writer& Writer::BaseContext::EndDict() {
+    return writer_.EndDict();
+}
+
+Writer& Writer::BaseContext::EndArray() {
+    return writer_.EndArray();
+}
+
+} // namespace json
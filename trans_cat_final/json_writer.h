@@ -0,0 +1,143 @@
+// json_writer.h
+
+#pragma once
+
+#include "json.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace json {
+
+// Пишет JSON сразу в буфер вывода, не создавая узлов Node.
+// Интерфейс и проверки контекста те же, что у json::Builder
+class Writer {
+public:
+    class DictItemContext;
+    class ArrayItemContext;
+    class DictValueContext;
+    class BaseContext {
+    public:
+        BaseContext(Writer& writer) : writer_(writer) {}
+        DictItemContext StartDict();
+        ArrayItemContext StartArray();
+        void Finish();
+
+        template <typename T>
+        Writer& Value(const T& value) {
+            return writer_.Value(value);
+        }
+        Writer& RawValue(std::string_view json);
+        DictValueContext Key(std::string_view key);
+        Writer& EndDict();
+        Writer& EndArray();
+    protected:
+        Writer& writer_;
+    };
+
+    class DictItemContext : public BaseContext {
+    public:
+        using BaseContext::BaseContext;
+        DictValueContext Key(std::string_view key);
+        Writer& EndDict();
+
+        DictItemContext StartDict() = delete;
+        ArrayItemContext StartArray() = delete;
+        void Finish() = delete;
+        template <typename T>
+        Writer& Value(const T& value) = delete;
+        Writer& RawValue(std::string_view json) = delete;
+        Writer& EndArray() = delete;
+    };
+
+    class DictValueContext : public BaseContext {
+    public:
+        using BaseContext::BaseContext;
+        template <typename T>
+        DictItemContext Value(const T& value) {
+            writer_.Value(value);
+            return DictItemContext(writer_);
+        }
+        DictItemContext RawValue(std::string_view json) {
+            writer_.RawValue(json);
+            return DictItemContext(writer_);
+        }
+        //
+        Writer& EndArray() = delete;
+        Writer& EndDict() = delete;
+        void Finish() = delete;
+        DictValueContext Key(std::string_view key) = delete;
+    };
+
+    class ArrayItemContext : public BaseContext {
+    public:
+        using BaseContext::BaseContext;
+        template <typename T>
+        ArrayItemContext Value(const T& value) {
+            writer_.Value(value);
+            return ArrayItemContext(writer_);
+        }
+        ArrayItemContext RawValue(std::string_view json) {
+            writer_.RawValue(json);
+            return ArrayItemContext(writer_);
+        }
+        //
+        Writer& EndDict() = delete;
+        DictValueContext Key(std::string_view key) = delete;
+        void Finish() = delete;
+    };
+
+    // Буфер сбрасывается в output, как только превысит flush_threshold байт
+    explicit Writer(std::ostream& output, DoubleFormat double_format = DoubleFormat::STREAM,
+                    size_t flush_threshold = 64 * 1024);
+    // Пишет в конец строки output, без промежуточного буфера
+    explicit Writer(std::string& output, DoubleFormat double_format = DoubleFormat::STREAM);
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+    ~Writer();
+
+    DictItemContext StartDict();
+    ArrayItemContext StartArray();
+    // Проверяет, что корневое значение записано полностью, и сбрасывает буфер
+    void Finish();
+
+    // Methods for internal use
+    Writer& Value(std::nullptr_t);
+    Writer& Value(bool value);
+    Writer& Value(int value);
+    Writer& Value(double value);
+    Writer& Value(std::string_view value);
+    Writer& Value(const std::string& value);
+    Writer& Value(const char* value);
+    Writer& Value(const Node& value);
+    // Вставляет уже сериализованное значение как есть
+    Writer& RawValue(std::string_view json);
+    DictValueContext Key(std::string_view key);
+    Writer& EndDict();
+    Writer& EndArray();
+
+private:
+    struct Scope {
+        bool is_dict;
+        bool empty;
+    };
+
+    void BeforeValue();
+    void WriteString(std::string_view value);
+    void FlushIfFull();
+    void Flush();
+
+    std::ostream* output_ = nullptr;
+    DoubleFormat double_format_;
+    size_t flush_threshold_ = 0;
+    std::string own_buffer_;
+    std::string& buffer_;
+    std::vector<Scope> scopes_;
+    bool key_expected_ = false;
+    bool root_written_ = false;
+};
+
+} // namespace json
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "cache_stats.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace cache {
+
+// Кеш с вытеснением по частоте обращений (LFU) и ограничением памяти в байтах.
+// Частота считается для всех запрошенных ключей, а не только для сохранённых:
+// новое значение вытесняет только те, к которым обращались реже.
+// Раз в aging_period обращений все счётчики делятся пополам, поэтому кеш
+// подстраивается под смену популярных ключей.
+// Все методы потокобезопасны
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class LfuCache {
+public:
+    explicit LfuCache(size_t byte_budget, size_t aging_period = 1 << 16)
+        : byte_budget_(byte_budget), aging_period_(aging_period) {}
+
+    // Учитывает обращение к key и возвращает сохранённое значение или nullptr
+    std::shared_ptr<const Value> Get(const Key& key) {
+        std::lock_guard guard(mutex_);
+        ++frequencies_[key];
+        if (++accesses_ % aging_period_ == 0) {
+            Age();
+        }
+        const auto it = entries_.find(key);
+        if (it == entries_.end()) {
+            ++stats_.misses;
+            return nullptr;
+        }
+        ++stats_.hits;
+        return it->second.value;
+    }
+
+    // Предлагает значение размером bytes; false — значение не сохранено
+    bool Offer(const Key& key, std::shared_ptr<const Value> value, size_t bytes) {
+        std::lock_guard guard(mutex_);
+        if (entries_.count(key)) {
+            return true;  // Уже сохранено другим потоком
+        }
+        if (bytes > byte_budget_) {
+            ++stats_.rejections;
+            return false;
+        }
+        const uint64_t frequency = frequencies_[key];
+        while (stats_.bytes + bytes > byte_budget_) {
+            // Значений в кеше немного (каждое крупное), поэтому
+            // самое редкое ищется простым перебором
+            auto victim = entries_.begin();
+            for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+                if (frequencies_[it->first] < frequencies_[victim->first]) {
+                    victim = it;
+                }
+            }
+            if (frequencies_[victim->first] >= frequency) {
+                ++stats_.rejections;
+                return false;
+            }
+            stats_.bytes -= victim->second.bytes;
+            entries_.erase(victim);
+            ++stats_.evictions;
+        }
+        entries_.emplace(key, Entry{std::move(value), bytes});
+        stats_.bytes += bytes;
+        return true;
+    }
+
+    CacheStats GetStats() const {
+        std::lock_guard guard(mutex_);
+        CacheStats stats = stats_;
+        stats.entries = entries_.size();
+        return stats;
+    }
+
+private:
+    struct Entry {
+        std::shared_ptr<const Value> value;
+        size_t bytes = 0;
+    };
+
+    void Age() {
+        for (auto it = frequencies_.begin(); it != frequencies_.end();) {
+            it->second /= 2;
+            if (it->second == 0 && entries_.count(it->first) == 0) {
+                it = frequencies_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    const size_t byte_budget_;
+    const size_t aging_period_;
+    mutable std::mutex mutex_;
+    std::unordered_map<Key, uint64_t, Hash> frequencies_;
+    std::unordered_map<Key, Entry, Hash> entries_;
+    uint64_t accesses_ = 0;
+    CacheStats stats_;
+};
+
+}  // namespace cache
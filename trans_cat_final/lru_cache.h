@@ -0,0 +1,145 @@
+#pragma once
+
+#include "cache_stats.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace cache {
+
+// Кеш с вытеснением давно не использованных значений (LRU) и ограничением
+// памяти в байтах. Ключи распределены по шардам со своими блокировками,
+// чтобы потоки, обращающиеся к разным ключам, не ждали друг друга.
+// Бюджет делится между шардами поровну. Все методы потокобезопасны
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class ShardedLruCache {
+public:
+    explicit ShardedLruCache(size_t byte_budget, size_t shard_count = 16)
+        : shard_count_(shard_count > 0 ? shard_count : 1)
+        , shard_budget_(byte_budget / shard_count_)
+        , shards_(std::make_unique<Shard[]>(shard_count_)) {
+    }
+
+    // Значение по ключу или nullptr; найденное значение становится самым свежим
+    std::shared_ptr<const Value> Get(const Key& key) {
+        Shard& shard = GetShard(key);
+        std::lock_guard guard(shard.mutex);
+        const auto it = shard.index.find(key);
+        if (it == shard.index.end()) {
+            ++shard.stats.misses;
+            return nullptr;
+        }
+        ++shard.stats.hits;
+        shard.items.splice(shard.items.begin(), shard.items, it->second);
+        return it->second->value;
+    }
+
+    // Сохраняет значение размером bytes, вытесняя самые старые
+    void Put(const Key& key, std::shared_ptr<const Value> value, size_t bytes) {
+        Shard& shard = GetShard(key);
+        std::lock_guard guard(shard.mutex);
+        Insert(shard, key, std::move(value), bytes);
+    }
+
+    // Как Put, но только если кеш не очищали с тех пор, как было получено
+    // generation (GetGeneration): значение, посчитанное по устаревшим
+    // данным, не попадёт в кеш после Clear
+    void Put(const Key& key, std::shared_ptr<const Value> value, size_t bytes, uint64_t generation) {
+        Shard& shard = GetShard(key);
+        std::lock_guard guard(shard.mutex);
+        if (generation != generation_.load()) {
+            return;
+        }
+        Insert(shard, key, std::move(value), bytes);
+    }
+
+    // Поколение содержимого: каждый Clear начинает новое
+    uint64_t GetGeneration() const {
+        return generation_.load();
+    }
+
+    // Удаляет все значения; счётчики обращений сохраняются
+    void Clear() {
+        // Сначала поколение: Put со старым номером, успевший в шард до его
+        // очистки, будет стёрт, а опоздавший — отвергнут
+        ++generation_;
+        for (size_t i = 0; i < shard_count_; ++i) {
+            Shard& shard = shards_[i];
+            std::lock_guard guard(shard.mutex);
+            shard.items.clear();
+            shard.index.clear();
+            shard.stats.bytes = 0;
+        }
+    }
+
+    CacheStats GetStats() const {
+        CacheStats result;
+        for (size_t i = 0; i < shard_count_; ++i) {
+            const Shard& shard = shards_[i];
+            std::lock_guard guard(shard.mutex);
+            result.hits += shard.stats.hits;
+            result.misses += shard.stats.misses;
+            result.evictions += shard.stats.evictions;
+            result.rejections += shard.stats.rejections;
+            result.entries += shard.items.size();
+            result.bytes += shard.stats.bytes;
+        }
+        return result;
+    }
+
+private:
+    struct Item {
+        Key key;
+        std::shared_ptr<const Value> value;
+        size_t bytes = 0;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        // Свежие значения в начале списка
+        std::list<Item> items;
+        std::unordered_map<Key, typename std::list<Item>::iterator, Hash> index;
+        CacheStats stats;
+    };
+
+    // Вызывается под блокировкой шарда
+    void Insert(Shard& shard, const Key& key, std::shared_ptr<const Value> value, size_t bytes) {
+        if (bytes > shard_budget_) {
+            ++shard.stats.rejections;
+            return;
+        }
+        if (const auto it = shard.index.find(key); it != shard.index.end()) {
+            shard.stats.bytes -= it->second->bytes;
+            shard.items.erase(it->second);
+            shard.index.erase(it);
+        }
+        while (shard.stats.bytes + bytes > shard_budget_) {
+            const Item& oldest = shard.items.back();
+            shard.stats.bytes -= oldest.bytes;
+            shard.index.erase(oldest.key);
+            shard.items.pop_back();
+            ++shard.stats.evictions;
+        }
+        shard.items.push_front(Item{key, std::move(value), bytes});
+        shard.index.emplace(key, shard.items.begin());
+        shard.stats.bytes += bytes;
+    }
+
+    Shard& GetShard(const Key& key) {
+        return shards_[Hash{}(key) % shard_count_];
+    }
+
+    const size_t shard_count_;
+    const size_t shard_budget_;
+    std::unique_ptr<Shard[]> shards_;
+    std::atomic<uint64_t> generation_{0};
+};
+
+}  // namespace cache
@@ -1,19 +1,263 @@
+#include <charconv>
+#include <cmath>
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
 #include "transport_catalogue.h"
 #include "json_reader.h"
+#include "server.h"
+#include "svgz.h"
 
 using namespace std;
 using namespace transport_catalogue;
 
-int main()
+void PrintCacheStats(const json_reader::JsonReader& reader) {
+    if (const auto route_cache = reader.GetRouteCacheStats()) {
+        cerr << "route cache: hits "sv << route_cache->hits
+             << ", misses "sv << route_cache->misses
+             << ", evictions "sv << route_cache->evictions
+             << ", entries "sv << route_cache->entries
+             << ", bytes "sv << route_cache->bytes << endl;
+    }
+    if (const auto tree_cache = reader.GetTreeCacheStats()) {
+        cerr << "tree cache: hits "sv << tree_cache->hits
+             << ", misses "sv << tree_cache->misses
+             << ", evictions "sv << tree_cache->evictions
+             << ", rejections "sv << tree_cache->rejections
+             << ", trees "sv << tree_cache->entries
+             << ", bytes "sv << tree_cache->bytes << endl;
+    }
+}
+
+void PrintStats(const json_reader::JsonReader& reader, bool enabled) {
+    if (!enabled) {
+        return;
+    }
+    const auto& stats = reader.GetBatchStats();
+    cerr << "requests: "sv << stats.request_count
+         << ", distinct: "sv << stats.distinct_count
+         << ", route origins: "sv << stats.route_origin_count << endl;
+    PrintCacheStats(reader);
+}
+
+// Потоков больше этого не нужно ни одному режиму; большее число — скорее опечатка
+constexpr size_t MAX_THREADS = 1024;
+
+// Сторона плитки в пикселях: меньше пикселя плитка бессмысленна,
+// больше 65536 — уже не плитка
+constexpr double MIN_TILE_SIZE = 1;
+constexpr double MAX_TILE_SIZE = 65536;
+
+// Числовое значение флага prefix<значение>: строка должна быть числом целиком
+// и лежать в [min, max]. Иначе invalid_argument с текстом для пользователя
+template <typename Number>
+Number ParseValue(string_view arg, string_view prefix,
+                  Number min = numeric_limits<Number>::lowest(), Number max = numeric_limits<Number>::max()) {
+    const string_view value = arg.substr(prefix.size());
+    Number result{};
+    const auto [ptr, ec] = from_chars(value.data(), value.data() + value.size(), result);
+    bool valid = ec == errc{} && ptr == value.data() + value.size();
+    if constexpr (is_floating_point_v<Number>) {
+        valid = valid && isfinite(result);
+    }
+    if (!valid) {
+        throw invalid_argument("Invalid value in option "s + string(arg) + ": a number is expected"s);
+    }
+    if (result < min || result > max) {
+        ostringstream message;
+        message << "Invalid value in option "sv << arg << ": expected "sv;
+        if (max == numeric_limits<Number>::max()) {
+            message << "at least "sv << min;
+        } else {
+            message << min << ".."sv << max;
+        }
+        throw invalid_argument(message.str());
+    }
+    return result;
+}
+
+int main(int argc, char* argv[])
 {
+    // Потоки конвейера и сервера не должны платить за синхронизацию с stdio
+    ios::sync_with_stdio(false);
+    json_reader::ReaderSettings settings;
+    bool print_stats = false;
+    bool serve_frames = false;
+    bool pipeline = false;
+    bool serve_lines = false;
+    size_t flush_every = 1;
+    string base_path;
+    string socket_path;
+    string tiles_dir;
+    string tiles_archive;
+    tiles::PyramidSettings pyramid;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const string_view arg = argv[i];
+            if (arg == "--lazy-stats"sv) {
+                settings.lazy_stat_requests = true;
+            } else if (arg == "--intern-strings"sv) {
+                settings.intern_strings = true;
+            } else if (arg == "--parallel"sv) {
+                settings.parallel_stat_requests = true;
+            } else if (arg.substr(0, "--threads="sv.size()) == "--threads="sv) {
+                settings.parallel_stat_requests = true;
+                settings.thread_count = ParseValue<size_t>(arg, "--threads="sv, size_t{0}, MAX_THREADS);
+            } else if (arg == "--coalesce"sv) {
+                settings.coalesce_requests = true;
+            } else if (arg == "--single-source-routing"sv) {
+                settings.router_mode = transport::RouterMode::SINGLE_SOURCE;
+            } else if (arg == "--serve"sv) {
+                serve_frames = true;
+            } else if (arg.substr(0, "--socket="sv.size()) == "--socket="sv) {
+                socket_path = string(arg.substr("--socket="sv.size()));
+            } else if (arg == "--router=eager"sv) {
+                settings.router_build = json_reader::RouterBuild::EAGER;
+            } else if (arg == "--router=lazy"sv) {
+                settings.router_build = json_reader::RouterBuild::LAZY;
+            } else if (arg == "--router=background"sv) {
+                settings.router_build = json_reader::RouterBuild::BACKGROUND;
+            } else if (arg == "--pipeline"sv) {
+                pipeline = true;
+            } else if (arg.substr(0, "--pipeline-depth="sv.size()) == "--pipeline-depth="sv) {
+                pipeline = true;
+                settings.pipeline_depth = ParseValue<size_t>(arg, "--pipeline-depth="sv, size_t{1});
+            } else if (arg == "--lines"sv) {
+                serve_lines = true;
+            } else if (arg.substr(0, "--flush-every="sv.size()) == "--flush-every="sv) {
+                serve_lines = true;
+                flush_every = ParseValue<size_t>(arg, "--flush-every="sv, size_t{1});
+            } else if (arg.substr(0, "--base="sv.size()) == "--base="sv) {
+                base_path = string(arg.substr("--base="sv.size()));
+            } else if (arg.substr(0, "--tree-cache="sv.size()) == "--tree-cache="sv) {
+                settings.tree_cache_bytes = ParseValue<size_t>(arg, "--tree-cache="sv);
+            } else if (arg.substr(0, "--route-cache="sv.size()) == "--route-cache="sv) {
+                settings.route_cache_bytes = ParseValue<size_t>(arg, "--route-cache="sv);
+            } else if (arg == "--route-cache-objects"sv) {
+                settings.route_cache_json = false;
+            } else if (arg == "--stream-map"sv) {
+                settings.map_output.mode = renderer::RenderMode::STREAM;
+            } else if (arg == "--compact-map"sv) {
+                settings.map_output.mode = renderer::RenderMode::COMPACT;
+            } else if (arg.substr(0, "--map-precision="sv.size()) == "--map-precision="sv) {
+                settings.map_output.number_format = {svg::NumberStyle::GENERAL,
+                                              ParseValue<int>(arg, "--map-precision="sv, 0, svg::MAX_PRECISION)};
+            } else if (arg.substr(0, "--map-fixed="sv.size()) == "--map-fixed="sv) {
+                settings.map_output.number_format = {svg::NumberStyle::FIXED,
+                                              ParseValue<int>(arg, "--map-fixed="sv, 0, svg::MAX_PRECISION)};
+            } else if (arg == "--map-shortest"sv) {
+                settings.map_output.number_format.style = svg::NumberStyle::SHORTEST;
+            } else if (arg.substr(0, "--map-threads="sv.size()) == "--map-threads="sv) {
+                settings.map_output.thread_count = ParseValue<size_t>(arg, "--map-threads="sv, size_t{0}, MAX_THREADS);
+            } else if (arg.substr(0, "--map-svgz="sv.size()) == "--map-svgz="sv) {
+                settings.map_svgz_level = ParseValue<int>(arg, "--map-svgz="sv, svgz::MIN_LEVEL, svgz::MAX_LEVEL);
+            } else if (arg.substr(0, "--tile-size="sv.size()) == "--tile-size="sv) {
+                settings.map_tile_size = ParseValue<double>(arg, "--tile-size="sv, MIN_TILE_SIZE, MAX_TILE_SIZE);
+            } else if (arg.substr(0, "--tiles-dir="sv.size()) == "--tiles-dir="sv) {
+                tiles_dir = string(arg.substr("--tiles-dir="sv.size()));
+            } else if (arg.substr(0, "--tiles-archive="sv.size()) == "--tiles-archive="sv) {
+                tiles_archive = string(arg.substr("--tiles-archive="sv.size()));
+            } else if (arg.substr(0, "--tiles-zoom="sv.size()) == "--tiles-zoom="sv) {
+                pyramid.max_zoom = ParseValue<int>(arg, "--tiles-zoom="sv, 0, renderer::TileId::MAX_ZOOM);
+            } else if (arg == "--css-classes"sv) {
+                settings.map_output.style_mode = svg::StyleMode::CLASSES;
+            } else if (arg.substr(0, "--map-simplify="sv.size()) == "--map-simplify="sv) {
+                settings.map_detail.tolerance = ParseValue<double>(arg, "--map-simplify="sv, 0.0);
+            } else if (arg == "--map-cull"sv) {
+                settings.map_detail.cull_overlaps = true;
+            } else if (arg == "--stats"sv) {
+                print_stats = true;
+            } else if (arg == "--shortest-numbers"sv) {
+                settings.double_format = json::DoubleFormat::SHORTEST;
+            } else {
+                cerr << "Unknown option: "sv << arg << endl;
+                return 1;
+            }
+        }
+    } catch (const invalid_argument& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    const bool serve = serve_frames || serve_lines || !socket_path.empty();
+    if (serve && base_path.empty()) {
+        // За базовыми данными в stdin идут запросы, по одному на строку.
+        // Ленивый документ прочитал бы весь поток сразу
+        settings.lazy_stat_requests = false;
+    }
     // 1. Создаем транспортный каталог
     transport_catalogue::TransportCatalogue catalogue;
     // 2. Создаем JSON-ридер, передаем ему каталог
-    json_reader::JsonReader reader(catalogue);
+    json_reader::JsonReader reader(catalogue, settings);
+    if (pipeline && !serve && base_path.empty()) {
+        reader.ProcessStream(std::cin, std::cout);
+        PrintStats(reader, print_stats);
+        return 0;
+    }
     // 3. Загружаем данные из std::cin (куда перенаправлен input.json)
-    reader.LoadData(std::cin);
-    //reader.ProcessRequests(std::cout);
+    // либо из заранее сохранённого файла базовых данных
+    if (base_path.empty()) {
+        reader.LoadData(std::cin);
+    } else {
+        ifstream base(base_path);
+        if (!base) {
+            cerr << "Cannot open "sv << base_path << endl;
+            return 1;
+        }
+        reader.LoadData(base);
+    }
+    if (!tiles_dir.empty() || !tiles_archive.empty()) {
+        // Пакетный режим: вместо ответов на stat_requests — пирамида плиток
+        pyramid.tile_size = settings.map_tile_size;
+        pyramid.thread_count = settings.thread_count;
+        pyramid.svgz_level = settings.map_svgz_level;
+        try {
+            unique_ptr<tiles::TileSink> sink;
+            if (!tiles_archive.empty()) {
+                sink = make_unique<tiles::ArchiveSink>(tiles_archive);
+            } else {
+                sink = make_unique<tiles::DirectorySink>(tiles_dir, pyramid.svgz_level ? ".svgz"s : ".svg"s);
+            }
+            const auto stats = reader.RenderTiles(pyramid, *sink);
+            if (print_stats) {
+                cerr << "tiles: "sv << stats.tile_count << ", bytes: "sv << stats.bytes << endl;
+            }
+        } catch (const exception& e) {
+            cerr << e.what() << endl;
+            return 1;
+        }
+        return 0;
+    }
+    if (serve_lines) {
+        const auto latency = server::ServeLines(reader, std::cin, std::cout, flush_every);
+        if (print_stats) {
+            cerr << "requests: "sv << latency.count
+                 << ", p50: "sv << latency.p50.count() << "us"sv
+                 << ", p99: "sv << latency.p99.count() << "us"sv
+                 << ", max: "sv << latency.max.count() << "us"sv << endl;
+            PrintCacheStats(reader);
+        }
+        return 0;
+    }
+    if (serve_frames) {
+        server::ServeFrames(reader, std::cin, std::cout);
+        return 0;
+    }
+    if (!socket_path.empty()) {
+        try {
+            server::ServeUnixSocket(reader, socket_path);
+        } catch (const exception& e) {
+            cerr << e.what() << endl;
+            return 1;
+        }
+        return 0;
+    }
     reader.ProcessRequests(std::cout);
+    PrintStats(reader, print_stats);
     return 0;
 }
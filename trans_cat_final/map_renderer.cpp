@@ -1,7 +1,969 @@
 #include "map_renderer.h"
+#include "parallel.h"
+
+#include <cmath>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
 
 /*
  * В этом файле вы можете разместить код, отвечающий за визуализацию карты маршрутов в формате SVG.
  * Визуализация маршртутов вам понадобится во второй части итогового проекта.
  * Пока можете оставить файл пустым.
- */
\ No newline at end of file
+ */
+
+namespace renderer {
+
+bool operator==(const RenderSettings& lhs, const RenderSettings& rhs) {
+    auto same_point = [](svg::Point a, svg::Point b) {
+        return a.x == b.x && a.y == b.y;
+    };
+    return lhs.width == rhs.width && lhs.height == rhs.height && lhs.padding == rhs.padding
+        && lhs.line_width == rhs.line_width && lhs.stop_radius == rhs.stop_radius
+        && lhs.bus_label_font_size == rhs.bus_label_font_size
+        && same_point(lhs.bus_label_offset, rhs.bus_label_offset)
+        && lhs.stop_label_font_size == rhs.stop_label_font_size
+        && same_point(lhs.stop_label_offset, rhs.stop_label_offset)
+        && lhs.underlayer_color == rhs.underlayer_color && lhs.underlayer_width == rhs.underlayer_width
+        && lhs.color_palette == rhs.color_palette;
+}
+
+namespace {
+
+using spatial::BoundingBox;
+using transport_catalogue::Coordinates;
+
+// Часть отрезка from-to внутри area (алгоритм Лианга — Барски): доли
+// t0 <= t1 его длины от начала. nullopt — отрезок целиком снаружи
+std::optional<std::pair<double, double>> ClipSegment(Coordinates from, Coordinates to, const BoundingBox& area) {
+    double t0 = 0;
+    double t1 = 1;
+    // Ограничение p * t <= q
+    auto clip = [&t0, &t1](double p, double q) {
+        if (p == 0) {
+            return q >= 0;
+        }
+        const double t = q / p;
+        if (p < 0) {
+            if (t > t1) {
+                return false;
+            }
+            t0 = std::max(t0, t);
+        } else {
+            if (t < t0) {
+                return false;
+            }
+            t1 = std::min(t1, t);
+        }
+        return true;
+    };
+    const double d_lng = to.lng - from.lng;
+    const double d_lat = to.lat - from.lat;
+    if (clip(-d_lng, from.lng - area.min_lng) && clip(d_lng, area.max_lng - from.lng)
+        && clip(-d_lat, from.lat - area.min_lat) && clip(d_lat, area.max_lat - from.lat)) {
+        return std::pair{t0, t1};
+    }
+    return std::nullopt;
+}
+
+Coordinates Interpolate(Coordinates from, Coordinates to, double t) {
+    return {from.lat + (to.lat - from.lat) * t, from.lng + (to.lng - from.lng) * t};
+}
+
+// Квадрат расстояния от point до отрезка from-to на плоскости (долгота, широта):
+// проекция карты растягивает обе оси одинаково
+double SquaredDistance(Coordinates point, Coordinates from, Coordinates to) {
+    const double d_lng = to.lng - from.lng;
+    const double d_lat = to.lat - from.lat;
+    const double length = d_lng * d_lng + d_lat * d_lat;
+    double t = 0;
+    if (length > 0) {
+        t = std::clamp(((point.lng - from.lng) * d_lng + (point.lat - from.lat) * d_lat) / length, 0.0, 1.0);
+    }
+    const double x = from.lng + d_lng * t - point.lng;
+    const double y = from.lat + d_lat * t - point.lat;
+    return x * x + y * y;
+}
+
+// Вершины ломаной автобуса: все остановки пути либо только оставшиеся после упрощения
+struct PathView {
+    const transport_catalogue::Stop* const* stops = nullptr;
+    const uint32_t* kept = nullptr;
+    size_t size = 0;
+
+    Coordinates operator[](size_t k) const {
+        return stops[kept ? kept[k] : k]->coordinates;
+    }
+};
+
+PathView MakePathView(const MapLayout& layout, size_t bus, const SimplifiedPaths* paths) {
+    const auto& line = layout.buses[bus];
+    PathView view{layout.path_stops.data() + line.path_begin, nullptr, line.path_end - line.path_begin};
+    if (paths) {
+        view.kept = paths->kept.data() + paths->begin[bus];
+        view.size = paths->begin[bus + 1] - paths->begin[bus];
+    }
+    return view;
+}
+
+// Прямоугольники, уже занятые на изображении. Сетка из квадратов со
+// стороной cell: проверяются только прямоугольники из задетых ячеек
+class OverlapGrid {
+public:
+    explicit OverlapGrid(double cell)
+        : cell_(cell > 0 ? cell : 1) {}
+
+    // Занимает прямоугольник, если он не пересекается с уже занятыми
+    bool TryPlace(svg::Point min, svg::Point max) {
+        const auto [col_begin, col_end] = Span(min.x, max.x);
+        const auto [row_begin, row_end] = Span(min.y, max.y);
+        for (int64_t row = row_begin; row <= row_end; ++row) {
+            for (int64_t col = col_begin; col <= col_end; ++col) {
+                const auto it = cells_.find(Key(row, col));
+                if (it == cells_.end()) {
+                    continue;
+                }
+                for (const uint32_t i : it->second) {
+                    const Rect& rect = rects_[i];
+                    if (min.x < rect.max.x && rect.min.x < max.x && min.y < rect.max.y && rect.min.y < max.y) {
+                        return false;
+                    }
+                }
+            }
+        }
+        const auto index = static_cast<uint32_t>(rects_.size());
+        rects_.push_back({min, max});
+        for (int64_t row = row_begin; row <= row_end; ++row) {
+            for (int64_t col = col_begin; col <= col_end; ++col) {
+                cells_[Key(row, col)].push_back(index);
+            }
+        }
+        return true;
+    }
+
+private:
+    struct Rect {
+        svg::Point min;
+        svg::Point max;
+    };
+
+    std::pair<int64_t, int64_t> Span(double min, double max) const {
+        return {static_cast<int64_t>(std::floor(min / cell_)), static_cast<int64_t>(std::floor(max / cell_))};
+    }
+    static uint64_t Key(int64_t row, int64_t col) {
+        return (static_cast<uint64_t>(row) << 32) ^ static_cast<uint32_t>(col);
+    }
+
+    double cell_;
+    std::vector<Rect> rects_;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> cells_;
+};
+
+// Число символов UTF-8: считаем первые байты
+size_t CountChars(const std::string& text) {
+    return std::count_if(text.begin(), text.end(), [](char c) {
+        return (static_cast<unsigned char>(c) & 0xC0) != 0x80;
+    });
+}
+
+// Примерная рамка подписи: ширина символа Verdana — около 0.6 размера шрифта
+std::pair<svg::Point, svg::Point> LabelBox(svg::Point position, svg::Point offset, int font_size,
+                                           const std::string& text) {
+    const double x = position.x + offset.x;
+    const double y = position.y + offset.y;
+    return {{x, y - font_size}, {x + 0.6 * font_size * static_cast<double>(CountChars(text)), y}};
+}
+
+// Насколько далеко от своей точки на изображении объект может заходить
+// в каждую сторону: кружок, линия или подпись не длиннее label_length
+// символов с подложкой. Подписи уходят от точки вправо и вверх
+struct Reach {
+    double left = 0;
+    double right = 0;
+    double up = 0;
+    double down = 0;
+};
+
+Reach ObjectReach(const RenderSettings& settings, size_t label_length) {
+    const double round = std::max(settings.stop_radius, settings.line_width / 2);
+    Reach reach{round, round, round, round};
+    const double halo = settings.underlayer_width / 2;
+    // Рамка подписи — как в LabelBox
+    auto add_label = [&](svg::Point offset, int font_size) {
+        const double width = 0.6 * font_size * static_cast<double>(label_length);
+        reach.left = std::max(reach.left, halo - offset.x);
+        reach.right = std::max(reach.right, halo + offset.x + width);
+        reach.up = std::max(reach.up, halo + font_size - offset.y);
+        reach.down = std::max(reach.down, halo + offset.y);
+    };
+    add_label(settings.bus_label_offset, settings.bus_label_font_size);
+    add_label(settings.stop_label_offset, settings.stop_label_font_size);
+    return reach;
+}
+
+// Дописывает в path остановки ломаной автобуса: прямой путь и, для
+// некольцевого маршрута, обратный (кроме последней остановки).
+// Возвращает число остановок прямого пути
+size_t AppendPath(const transport_catalogue::TransportCatalogue& catalogue, const transport_catalogue::Bus& bus,
+                  std::vector<const transport_catalogue::Stop*>& path) {
+    const auto& route = bus.route;
+    const size_t begin = path.size();
+    for (const auto& stop_name : route) {
+        if (const auto* stop = catalogue.FindStop(stop_name)) {
+            path.push_back(stop);
+        }
+    }
+    const size_t forward_size = path.size() - begin;
+    if (!bus.is_roundtrip && !route.empty()) {
+        for (auto it = route.rbegin() + 1; it != route.rend(); ++it) {
+            if (const auto* stop = catalogue.FindStop(*it)) {
+                path.push_back(stop);
+            }
+        }
+    }
+    return forward_size;
+}
+
+// Остановки, у которых подписывается название автобуса; nullptr — подписи нет
+std::pair<const transport_catalogue::Stop*, const transport_catalogue::Stop*> FindLabelStops(
+    const transport_catalogue::TransportCatalogue& catalogue, const transport_catalogue::Bus& bus) {
+    if (bus.route.empty()) {
+        return {nullptr, nullptr};
+    }
+    const auto* first_stop = catalogue.FindStop(bus.route.front());
+    const transport_catalogue::Stop* last_stop = nullptr;
+    if (!bus.is_roundtrip) {
+        last_stop = catalogue.FindStop(bus.route.back());
+        if (last_stop == first_stop) {
+            last_stop = nullptr;
+        }
+    }
+    return {first_stop, last_stop};
+}
+
+template <typename Stops>
+SphereProjector MakeProjector(const Stops& stops, const RenderSettings& settings) {
+    std::vector<Coordinates> coords;
+    coords.reserve(stops.size());
+    for (const auto* stop : stops) {
+        coords.push_back(stop->coordinates);
+    }
+    return SphereProjector(coords.begin(), coords.end(), settings.width, settings.height, settings.padding);
+}
+
+}  // namespace
+
+MapLayout::MapLayout(const transport_catalogue::TransportCatalogue& catalogue) {
+    for (const auto& [name, bus_ptr] : catalogue.GetAllBuses()) {
+        buses.push_back({bus_ptr});
+    }
+    std::sort(buses.begin(), buses.end(), [](const BusLine& lhs, const BusLine& rhs) {
+        return lhs.bus->name < rhs.bus->name;
+    });
+    for (BusLine& line : buses) {
+        line.path_begin = path_stops.size();
+        const size_t forward_size = AppendPath(catalogue, *line.bus, path_stops);
+        stops.insert(stops.end(), path_stops.begin() + line.path_begin,
+                     path_stops.begin() + line.path_begin + forward_size);
+        line.path_end = path_stops.size();
+        std::tie(line.first_stop, line.last_stop) = FindLabelStops(catalogue, *line.bus);
+    }
+    std::sort(stops.begin(), stops.end(), [](const auto* lhs, const auto* rhs) {
+        return lhs->name < rhs->name;
+    });
+    stops.erase(std::unique(stops.begin(), stops.end()), stops.end());
+}
+
+MapIndex::MapIndex(const transport_catalogue::TransportCatalogue& catalogue)
+    : layout_(catalogue) {
+    if (!layout_.stops.empty()) {
+        bounds_ = BoundingBox::Of(layout_.stops.front()->coordinates);
+    }
+    for (const auto* stop : layout_.stops) {
+        bounds_.Extend(stop->coordinates);
+        max_label_length_ = std::max(max_label_length_, CountChars(stop->name));
+    }
+    for (const auto& line : layout_.buses) {
+        max_label_length_ = std::max(max_label_length_, CountChars(line.bus->name));
+    }
+    using Grid = spatial::GridIndex<uint32_t>;
+    stop_grid_ = Grid(bounds_, Grid::SideForPoints(layout_.stops.size()));
+    for (size_t i = 0; i < layout_.stops.size(); ++i) {
+        stop_grid_.Insert(BoundingBox::Of(layout_.stops[i]->coordinates), static_cast<uint32_t>(i));
+    }
+    // Участок ломаной записывается в ячейки вдоль себя, и длинные участки
+    // заняли бы слишком много ячеек мелкой сетки. Поэтому сетка тем крупнее,
+    // чем длиннее участки относительно размеров карты
+    const double span_lat = bounds_.max_lat - bounds_.min_lat;
+    const double span_lng = bounds_.max_lng - bounds_.min_lng;
+    tile_side_ = std::max({span_lat, span_lng, EPSILON});
+    size_t segment_count = 0;
+    double length = 0;
+    for (const auto& line : layout_.buses) {
+        for (size_t k = line.path_begin; k + 1 < line.path_end; ++k) {
+            const auto from = layout_.path_stops[k]->coordinates;
+            const auto to = layout_.path_stops[k + 1]->coordinates;
+            length += (span_lat > 0 ? std::abs(to.lat - from.lat) / span_lat : 0)
+                    + (span_lng > 0 ? std::abs(to.lng - from.lng) / span_lng : 0);
+            ++segment_count;
+        }
+    }
+    bus_grid_ = Grid(bounds_, Grid::SideForSegments(segment_count, length));
+    for (size_t i = 0; i < layout_.buses.size(); ++i) {
+        const auto& line = layout_.buses[i];
+        if (line.path_begin == line.path_end) {
+            continue;
+        }
+        const auto bus = static_cast<uint32_t>(i);
+        if (line.path_end - line.path_begin == 1) {
+            bus_grid_.Insert(BoundingBox::Of(layout_.path_stops[line.path_begin]->coordinates), bus);
+        }
+        for (size_t k = line.path_begin; k + 1 < line.path_end; ++k) {
+            bus_grid_.InsertSegment(layout_.path_stops[k]->coordinates, layout_.path_stops[k + 1]->coordinates, bus);
+        }
+    }
+}
+
+SimplifiedPaths SimplifyPaths(const MapLayout& layout, double tolerance) {
+    SimplifiedPaths result;
+    result.begin.reserve(layout.buses.size() + 1);
+    const double limit = tolerance * tolerance;
+    std::vector<char> keep;
+    std::vector<std::pair<size_t, size_t>> ranges;
+    for (size_t i = 0; i < layout.buses.size(); ++i) {
+        result.begin.push_back(result.kept.size());
+        PathView path = MakePathView(layout, i, nullptr);
+        if (!layout.buses[i].bus->is_roundtrip) {
+            // Обратный путь проходит по тем же точкам и рисуется поверх прямого
+            // тем же цветом: достаточно прямого
+            path.size = (path.size + 1) / 2;
+        }
+        if (path.size <= 2) {
+            for (size_t k = 0; k < path.size; ++k) {
+                result.kept.push_back(static_cast<uint32_t>(k));
+            }
+            continue;
+        }
+        // Концы остаются всегда; внутри отрезка [first, last] остаётся
+        // самая далёкая от него вершина, если она дальше tolerance
+        keep.assign(path.size, 0);
+        keep.front() = keep.back() = 1;
+        ranges.assign(1, {0, path.size - 1});
+        while (!ranges.empty()) {
+            const auto [first, last] = ranges.back();
+            ranges.pop_back();
+            double farthest = limit;
+            size_t split = first;
+            for (size_t k = first + 1; k < last; ++k) {
+                const double distance = SquaredDistance(path[k], path[first], path[last]);
+                if (distance > farthest) {
+                    farthest = distance;
+                    split = k;
+                }
+            }
+            if (split != first) {
+                keep[split] = 1;
+                ranges.emplace_back(first, split);
+                ranges.emplace_back(split, last);
+            }
+        }
+        for (size_t k = 0; k < path.size; ++k) {
+            if (keep[k]) {
+                result.kept.push_back(static_cast<uint32_t>(k));
+            }
+        }
+    }
+    result.begin.push_back(result.kept.size());
+    return result;
+}
+
+std::shared_ptr<const SimplifiedPaths> MapIndex::GetSimplifiedPaths(double tolerance) const {
+    std::lock_guard guard(simplified_mutex_);
+    if (const auto it = simplified_.find(tolerance); it != simplified_.end()) {
+        return it->second;
+    }
+    if (simplified_.size() >= MAX_SIMPLIFIED) {
+        // Настройки отрисовки менялись много раз: старые уровни уже не нужны
+        simplified_.clear();
+    }
+    auto paths = std::make_shared<const SimplifiedPaths>(SimplifyPaths(layout_, tolerance));
+    simplified_.emplace(tolerance, paths);
+    return paths;
+}
+
+std::vector<uint32_t> MapIndex::FindBuses(const spatial::BoundingBox& area) const {
+    return bus_grid_.Query(area);
+}
+
+std::vector<uint32_t> MapIndex::FindStops(const spatial::BoundingBox& area) const {
+    auto result = stop_grid_.Query(area);
+    result.erase(std::remove_if(result.begin(), result.end(), [&](uint32_t i) {
+        return !area.Contains(layout_.stops[i]->coordinates);
+    }), result.end());
+    return result;
+}
+
+spatial::BoundingBox MapIndex::GetTileArea(TileId tile) const {
+    const double side = std::ldexp(tile_side_, -tile.z);
+    // Северо-западный угол плитки уровня 0
+    const double north = (bounds_.min_lat + bounds_.max_lat + tile_side_) / 2;
+    const double west = (bounds_.min_lng + bounds_.max_lng - tile_side_) / 2;
+    return {north - (tile.y + 1.0) * side, west + tile.x * side, north - tile.y * side, west + (tile.x + 1.0) * side};
+}
+
+spatial::BoundingBox Viewport::Resolve(const spatial::BoundingBox& bounds) const {
+    if (box) {
+        return *box;
+    }
+    const double scale = std::pow(2.0, -zoom);
+    const double half_lat = (bounds.max_lat - bounds.min_lat) / 2 * scale;
+    const double half_lng = (bounds.max_lng - bounds.min_lng) / 2 * scale;
+    return {center.lat - half_lat, center.lng - half_lng, center.lat + half_lat, center.lng + half_lng};
+}
+
+void MapRenderer::Render(const transport_catalogue::TransportCatalogue& catalogue, std::ostream& output) const {
+    RenderTo(catalogue, output);
+}
+
+void MapRenderer::Render(const transport_catalogue::TransportCatalogue& catalogue, std::string& output) const {
+    RenderTo(catalogue, output);
+}
+
+svg::Point MapCache::Project(const transport_catalogue::Stop* stop) {
+    const auto [it, inserted] = points_.try_emplace(stop);
+    if (inserted) {
+        it->second = (*projector_)(stop->coordinates);
+    }
+    return it->second;
+}
+
+void MapRenderer::Render(const transport_catalogue::TransportCatalogue& catalogue, MapCache& cache,
+                         std::string& output) const {
+    RenderTo(catalogue, cache, output);
+}
+
+void MapRenderer::Render(const transport_catalogue::TransportCatalogue& catalogue, MapCache& cache,
+                         std::ostream& output) const {
+    RenderTo(catalogue, cache, output);
+}
+
+template <typename Output>
+void MapRenderer::RenderTo(const transport_catalogue::TransportCatalogue& catalogue, MapCache& cache,
+                           Output& output) const {
+    if (options_.style_mode != svg::StyleMode::INLINE || detail_.tolerance > 0 || detail_.cull_overlaps) {
+        RenderTo(catalogue, output);
+        return;
+    }
+    const svg::NumberFormat format = options_.number_format;
+    if (cache.settings_ != settings_ || cache.number_format_.style != format.style
+        || cache.number_format_.precision != format.precision) {
+        cache = MapCache();
+        cache.settings_ = settings_;
+        cache.number_format_ = format;
+    }
+    const uint64_t generation = ++cache.generation_;
+
+    // 1. Ломаные автобусов. Названия остановок ищутся в каталоге, только если
+    // автобус новый или в каталог добавлялись остановки
+    std::vector<const transport_catalogue::Bus*> buses;
+    buses.reserve(catalogue.GetAllBuses().size());
+    for (const auto& [name, bus] : catalogue.GetAllBuses()) {
+        buses.push_back(bus);
+    }
+    std::sort(buses.begin(), buses.end(), [](const auto* lhs, const auto* rhs) {
+        return lhs->name < rhs->name;
+    });
+    const bool stops_added = cache.stop_version_ != catalogue.GetStopVersion();
+    cache.stop_version_ = catalogue.GetStopVersion();
+    bool layout_changed = cache.buses_.size() != buses.size();
+    std::vector<MapCache::BusEntry*> entries;
+    entries.reserve(buses.size());
+    std::vector<const transport_catalogue::Stop*> path;
+    for (const auto* bus : buses) {
+        const auto [it, inserted] = cache.buses_.try_emplace(bus);
+        MapCache::BusEntry& entry = it->second;
+        entry.generation = generation;
+        entries.push_back(&entry);
+        if (!inserted && !stops_added) {
+            continue;
+        }
+        path.clear();
+        const size_t forward_size = AppendPath(catalogue, *bus, path);
+        const auto [first_stop, last_stop] = FindLabelStops(catalogue, *bus);
+        if (inserted || path != entry.path || first_stop != entry.first_stop || last_stop != entry.last_stop) {
+            entry.path = path;
+            entry.forward_size = forward_size;
+            entry.first_stop = first_stop;
+            entry.last_stop = last_stop;
+            entry.color = MapCache::NOT_RENDERED;
+            layout_changed = true;
+        }
+    }
+    // Заменённые автобусы
+    for (auto it = cache.buses_.begin(); it != cache.buses_.end();) {
+        it = it->second.generation == generation ? std::next(it) : cache.buses_.erase(it);
+    }
+
+    // 2. Остановки маршрутов и проекция. Если проекция сдвинулась,
+    // перерисовывается вся карта
+    bool stops_changed = !cache.projector_;
+    if (layout_changed) {
+        std::vector<const transport_catalogue::Stop*> stops;
+        for (const auto* entry : entries) {
+            stops.insert(stops.end(), entry->path.begin(), entry->path.begin() + entry->forward_size);
+        }
+        // Повторы убираются по адресу, а по имени сортируются уже разные остановки
+        std::sort(stops.begin(), stops.end());
+        stops.erase(std::unique(stops.begin(), stops.end()), stops.end());
+        std::sort(stops.begin(), stops.end(), [](const auto* lhs, const auto* rhs) {
+            return lhs->name < rhs->name;
+        });
+        if (stops != cache.stops_) {
+            cache.stops_ = std::move(stops);
+            stops_changed = true;
+        }
+    }
+    if (stops_changed) {
+        const SphereProjector projector = MakeProjector(cache.stops_, settings_);
+        if (!cache.projector_ || *cache.projector_ != projector) {
+            cache.projector_ = projector;
+            cache.points_.clear();
+            for (auto* entry : entries) {
+                entry->color = MapCache::NOT_RENDERED;
+            }
+        }
+    }
+
+    // 3. Фрагменты, которые нарисованы не с теми остановками, цветом или проекцией
+    const auto& palette = settings_.color_palette;
+    Prototypes prototypes = MakePrototypes();
+    cache.rendered_bus_count_ = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        MapCache::BusEntry& entry = *entries[i];
+        const size_t color = i % palette.size();
+        if (entry.color == color) {
+            continue;
+        }
+        entry.color = color;
+        ++cache.rendered_bus_count_;
+        entry.line.clear();
+        entry.labels.clear();
+        if (!buses[i]->route.empty()) {
+            svg::Fragment line(entry.line, format);
+            svg::Polyline& polyline = prototypes.bus_line;
+            polyline.ClearPoints();
+            polyline.SetStrokeColor(palette[color]);
+            for (const auto* stop : entry.path) {
+                polyline.AddPoint(cache.Project(stop));
+            }
+            line.Add(polyline);
+        }
+        svg::Fragment labels(entry.labels, format);
+        for (const auto* stop : {entry.first_stop, entry.last_stop}) {
+            if (stop) {
+                const svg::Point position = cache.Project(stop);
+                const std::string& name = buses[i]->name;
+                labels.Add(prototypes.bus_underlayer.SetPosition(position).SetData(name));
+                labels.Add(prototypes.bus_text.SetPosition(position).SetData(name).SetFillColor(palette[color]));
+            }
+        }
+    }
+    if (stops_changed) {
+        cache.stop_points_.clear();
+        cache.stop_labels_.clear();
+        svg::Fragment points(cache.stop_points_, format);
+        svg::Fragment labels(cache.stop_labels_, format);
+        for (const auto* stop : cache.stops_) {
+            const svg::Point position = cache.Project(stop);
+            points.Add(prototypes.stop_point.SetCenter(position));
+            labels.Add(prototypes.stop_underlayer.SetPosition(position).SetData(stop->name));
+            labels.Add(prototypes.stop_text.SetPosition(position).SetData(stop->name));
+        }
+    }
+
+    // 4. Карта из фрагментов в порядке слоёв
+    if constexpr (std::is_same_v<Output, std::string>) {
+        size_t size = output.size() + cache.stop_points_.size() + cache.stop_labels_.size();
+        for (const auto* entry : entries) {
+            size += entry->line.size() + entry->labels.size();
+        }
+        // С запасом на заголовок и закрывающий тег
+        output.reserve(size + 256);
+    }
+    svg::StreamDocument doc(output, format);
+    for (const auto* entry : entries) {
+        doc.AddRendered(entry->line);
+    }
+    for (const auto* entry : entries) {
+        doc.AddRendered(entry->labels);
+    }
+    doc.AddRendered(cache.stop_points_);
+    doc.AddRendered(cache.stop_labels_);
+    doc.Close();
+}
+
+void MapRenderer::Render(const MapIndex& index, const spatial::BoundingBox& area, std::string& output) const {
+    RenderTo(index, area, output);
+}
+
+void MapRenderer::Render(const MapIndex& index, const spatial::BoundingBox& area, std::ostream& output) const {
+    RenderTo(index, area, output);
+}
+
+template <typename Output>
+void MapRenderer::RenderTo(const MapIndex& index, const spatial::BoundingBox& area, Output& output) const {
+    const Selection selection{area, index.FindBuses(area), index.FindStops(area), std::nullopt};
+    auto project_box = [this](const spatial::BoundingBox& box) {
+        const std::vector<Coordinates> corners{{box.min_lat, box.min_lng}, {box.max_lat, box.max_lng}};
+        return SphereProjector(corners.begin(), corners.end(), settings_.width, settings_.height, settings_.padding);
+    };
+    const SphereProjector projector = project_box(area);
+    std::shared_ptr<const SimplifiedPaths> paths;
+    const double base_scale = project_box(index.GetBounds()).GetScale();
+    if (detail_.tolerance > 0 && base_scale > 0 && projector.GetScale() > 0) {
+        // Уровень округляется вверх: на нём градус не крупнее, чем в area,
+        // и отклонение на изображении не превышает tolerance
+        const double ratio = projector.GetScale() / base_scale;
+        const int level = std::max(0, static_cast<int>(std::ceil(std::log2(ratio) - 1e-9)));
+        paths = index.GetSimplifiedPaths(detail_.tolerance / std::ldexp(base_scale, level));
+    }
+    RenderTo(index.GetLayout(), projector, &selection, paths.get(), output);
+}
+
+bool MapRenderer::RenderTile(const MapIndex& index, TileId tile, double size, std::string& output) const {
+    return RenderTo(index, tile, size, output);
+}
+
+bool MapRenderer::RenderTile(const MapIndex& index, TileId tile, double size, std::ostream& output) const {
+    return RenderTo(index, tile, size, output);
+}
+
+template <typename Output>
+bool MapRenderer::RenderTo(const MapIndex& index, TileId tile, double size, Output& output) const {
+    const BoundingBox area = index.GetTileArea(tile);
+    const std::vector<Coordinates> corners{{area.min_lat, area.min_lng}, {area.max_lat, area.max_lng}};
+    const SphereProjector projector(corners.begin(), corners.end(), size, size, 0);
+    // Масштаб уровня считается по стороне плитки уровня 0, чтобы у всех
+    // плиток уровня он был одинаковым до последнего бита
+    const double scale = std::ldexp(size / index.GetTileSide(), tile.z);
+    // Объекты, чья точка лежит за краем плитки не дальше, чем они
+    // выступают в её сторону, тоже задевают плитку: например, подписи
+    // остановок западнее плитки
+    const Reach object = ObjectReach(settings_, index.GetMaxLabelLength());
+    const BoundingBox reach{area.min_lat - object.up / scale, area.min_lng - object.right / scale,
+                            area.max_lat + object.down / scale, area.max_lng + object.left / scale};
+    const Selection selection{reach, index.FindBuses(reach), index.FindStops(reach), svg::Point{size, size}};
+    const bool found = !selection.buses.empty() || !selection.stops.empty();
+    std::shared_ptr<const SimplifiedPaths> paths;
+    if (found && detail_.tolerance > 0) {
+        paths = index.GetSimplifiedPaths(detail_.tolerance / scale);
+    }
+    RenderTo(index.GetLayout(), projector, &selection, paths.get(), output);
+    return found;
+}
+
+template <typename Output>
+void MapRenderer::RenderTo(const transport_catalogue::TransportCatalogue& catalogue, Output& output) const {
+    const MapLayout layout(catalogue);
+    // Проектор строится только по остановкам из маршрутов
+    const SphereProjector projector = MakeProjector(layout.stops, settings_);
+    std::optional<SimplifiedPaths> paths;
+    if (detail_.tolerance > 0 && projector.GetScale() > 0) {
+        paths = SimplifyPaths(layout, detail_.tolerance / projector.GetScale());
+    }
+    RenderTo(layout, projector, nullptr, paths ? &*paths : nullptr, output);
+}
+
+template <typename Output>
+void MapRenderer::RenderTo(const MapLayout& layout, const SphereProjector& projector, const Selection* selection,
+                           const SimplifiedPaths* paths, Output& output) const {
+    Frame frame{layout, projector, selection, paths, {}};
+    frame.culling = Cull(frame);
+    const auto canvas = selection ? selection->canvas : std::nullopt;
+    const size_t thread_count = options_.thread_count == 0 ? parallel::DefaultThreadCount() : options_.thread_count;
+    if (thread_count > 1 && options_.style_mode == svg::StyleMode::INLINE) {
+        // Без классов все режимы выводят одно и то же
+        RenderParallel(frame, thread_count, output);
+    } else if (options_.mode == RenderMode::STREAM) {
+        svg::StreamDocument doc(output, options_.number_format, canvas);
+        Draw(frame, doc);
+        doc.Close();
+    } else if (options_.mode == RenderMode::COMPACT) {
+        svg::CompactDocument doc;
+        if (canvas) {
+            doc.SetSize(*canvas);
+        }
+        Draw(frame, doc);
+        doc.Render(output, options_.number_format, options_.style_mode);
+    } else {
+        svg::Document doc;
+        if (canvas) {
+            doc.SetSize(*canvas);
+        }
+        Draw(frame, doc);
+        doc.Render(output, options_.number_format, options_.style_mode);
+    }
+}
+
+template <typename Output>
+void MapRenderer::RenderParallel(const Frame& frame, size_t thread_count, Output& output) const {
+    struct Chunk {
+        Layer layer;
+        size_t begin;
+        size_t end;
+    };
+    // Каждый слой режется на несколько кусков на поток, чтобы потоки
+    // освобождались примерно одновременно, но не мельче MIN_CHUNK объектов
+    static constexpr size_t MIN_CHUNK = 128;
+    std::vector<Chunk> chunks;
+    for (const Layer layer : {Layer::BUS_LINES, Layer::BUS_LABELS, Layer::STOP_POINTS, Layer::STOP_LABELS}) {
+        const bool buses = layer == Layer::BUS_LINES || layer == Layer::BUS_LABELS;
+        const size_t count = buses ? frame.BusCount() : frame.StopCount();
+        const size_t step = std::max(MIN_CHUNK, (count + thread_count * 4 - 1) / (thread_count * 4));
+        for (size_t begin = 0; begin < count; begin += step) {
+            chunks.push_back({layer, begin, std::min(count, begin + step)});
+        }
+    }
+    svg::StreamDocument doc(output, options_.number_format,
+                            frame.selection ? frame.selection->canvas : std::nullopt);
+    parallel::OrderedForEach<std::string>(chunks.size(), thread_count, [&](size_t i) {
+        std::string objects;
+        {
+            svg::Fragment fragment(objects, options_.number_format);
+            DrawLayer(frame, chunks[i].layer, chunks[i].begin, chunks[i].end, fragment);
+        }
+        return objects;
+    }, [&doc](size_t, std::string objects) {
+        doc.AddRendered(objects);
+    });
+    doc.Close();
+}
+
+size_t MapRenderer::Frame::BusCount() const {
+    return selection ? selection->buses.size() : layout.buses.size();
+}
+
+size_t MapRenderer::Frame::StopCount() const {
+    return selection ? selection->stops.size() : layout.stops.size();
+}
+
+size_t MapRenderer::Frame::BusAt(size_t position) const {
+    return selection ? selection->buses[position] : position;
+}
+
+const transport_catalogue::Stop& MapRenderer::Frame::StopAt(size_t position) const {
+    return *layout.stops[selection ? selection->stops[position] : position];
+}
+
+bool MapRenderer::Frame::IsVisible(const transport_catalogue::Stop* stop) const {
+    return stop && (!selection || selection->area.Contains(stop->coordinates));
+}
+
+MapRenderer::Culling MapRenderer::Cull(const Frame& frame) const {
+    Culling culling;
+    if (!detail_.cull_overlaps) {
+        return culling;
+    }
+    // Подписи автобусов и остановок не должны ложиться друг на друга
+    OverlapGrid labels(4.0 * std::max(settings_.bus_label_font_size, settings_.stop_label_font_size));
+    auto place_label = [&](svg::Point position, svg::Point offset, int font_size, const std::string& text) {
+        const auto [min, max] = LabelBox(position, offset, font_size, text);
+        return labels.TryPlace(min, max);
+    };
+    for (size_t position = 0; position < frame.BusCount(); ++position) {
+        const auto& line = frame.layout.buses[frame.BusAt(position)];
+        for (const auto* stop : {line.first_stop, line.last_stop}) {
+            culling.bus_labels.push_back(frame.IsVisible(stop)
+                && place_label(frame.projector(stop->coordinates), settings_.bus_label_offset,
+                               settings_.bus_label_font_size, line.bus->name));
+        }
+    }
+    // Подпись есть только у нарисованного кружка
+    OverlapGrid circles(2 * settings_.stop_radius);
+    const double r = settings_.stop_radius;
+    for (size_t position = 0; position < frame.StopCount(); ++position) {
+        const auto& stop = frame.StopAt(position);
+        const svg::Point center = frame.projector(stop.coordinates);
+        const bool shown = circles.TryPlace({center.x - r, center.y - r}, {center.x + r, center.y + r});
+        culling.stops.push_back(shown);
+        culling.stop_labels.push_back(shown && place_label(center, settings_.stop_label_offset,
+                                                           settings_.stop_label_font_size, stop.name));
+    }
+    return culling;
+}
+
+template <typename Container>
+void MapRenderer::Draw(const Frame& frame, Container& doc) const {
+    DrawBusLines(frame, 0, frame.BusCount(), doc);
+    DrawBusLabels(frame, 0, frame.BusCount(), doc);
+    DrawStopPoints(frame, 0, frame.StopCount(), doc);
+    DrawStopLabels(frame, 0, frame.StopCount(), doc);
+}
+
+template <typename Container>
+void MapRenderer::DrawLayer(const Frame& frame, Layer layer, size_t begin, size_t end, Container& doc) const {
+    switch (layer) {
+    case Layer::BUS_LINES:
+        DrawBusLines(frame, begin, end, doc);
+        break;
+    case Layer::BUS_LABELS:
+        DrawBusLabels(frame, begin, end, doc);
+        break;
+    case Layer::STOP_POINTS:
+        DrawStopPoints(frame, begin, end, doc);
+        break;
+    case Layer::STOP_LABELS:
+        DrawStopLabels(frame, begin, end, doc);
+        break;
+    }
+}
+
+MapRenderer::Prototypes MapRenderer::MakePrototypes() const {
+    Prototypes prototypes;
+    prototypes.bus_line.SetStrokeWidth(settings_.line_width);
+    prototypes.bus_line.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
+    prototypes.bus_line.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+    prototypes.bus_line.SetFillColor("none");
+    // Подложка и основной текст названия автобуса
+    svg::Text& bus_underlayer = prototypes.bus_underlayer;
+    bus_underlayer.SetOffset(settings_.bus_label_offset);
+    bus_underlayer.SetFillColor(settings_.underlayer_color);
+    bus_underlayer.SetStrokeColor(settings_.underlayer_color);
+    bus_underlayer.SetStrokeWidth(settings_.underlayer_width);
+    bus_underlayer.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
+    bus_underlayer.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+    bus_underlayer.SetFontSize(settings_.bus_label_font_size);
+    bus_underlayer.SetFontFamily("Verdana");
+    bus_underlayer.SetFontWeight("bold");
+    svg::Text& bus_text = prototypes.bus_text;
+    bus_text.SetOffset(settings_.bus_label_offset);
+    bus_text.SetFontSize(settings_.bus_label_font_size);
+    bus_text.SetFontFamily("Verdana");
+    bus_text.SetFontWeight("bold");
+    prototypes.stop_point.SetRadius(settings_.stop_radius);
+    prototypes.stop_point.SetFillColor("white");
+    svg::Text& stop_underlayer = prototypes.stop_underlayer;
+    stop_underlayer.SetOffset(settings_.stop_label_offset);
+    stop_underlayer.SetFillColor(settings_.underlayer_color);
+    stop_underlayer.SetStrokeColor(settings_.underlayer_color);
+    stop_underlayer.SetStrokeWidth(settings_.underlayer_width);
+    stop_underlayer.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
+    stop_underlayer.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+    stop_underlayer.SetFontSize(settings_.stop_label_font_size);
+    stop_underlayer.SetFontFamily("Verdana");
+    svg::Text& stop_text = prototypes.stop_text;
+    stop_text.SetOffset(settings_.stop_label_offset);
+    stop_text.SetFontSize(settings_.stop_label_font_size);
+    stop_text.SetFontFamily("Verdana");
+    stop_text.SetFillColor("black");
+    return prototypes;
+}
+
+template <typename Container>
+void MapRenderer::DrawBusLines(const Frame& frame, size_t begin, size_t end, Container& doc) const {
+    const auto& palette = settings_.color_palette;
+    const auto& projector = frame.projector;
+    Prototypes prototypes = MakePrototypes();
+    svg::Polyline& polyline = prototypes.bus_line;
+    for (size_t position = begin; position < end; ++position) {
+        const size_t i = frame.BusAt(position);
+        if (frame.layout.buses[i].bus->route.empty()) {
+            continue;
+        }
+        polyline.ClearPoints();
+        polyline.SetStrokeColor(palette[i % palette.size()]);
+        const PathView path = MakePathView(frame.layout, i, frame.paths);
+        if (!frame.selection) {
+            for (size_t k = 0; k < path.size; ++k) {
+                polyline.AddPoint(projector(path[k]));
+            }
+            doc.Add(polyline);
+            continue;
+        }
+        // Обрезаем ломаную по области: каждый кусок внутри неё — отдельная ломаная
+        size_t point_count = 0;
+        auto flush = [&] {
+            if (point_count >= 2) {
+                doc.Add(polyline);
+            }
+            polyline.ClearPoints();
+            point_count = 0;
+        };
+        for (size_t k = 0; k + 1 < path.size; ++k) {
+            const Coordinates from = path[k];
+            const Coordinates to = path[k + 1];
+            const auto clipped = ClipSegment(from, to, frame.selection->area);
+            if (!clipped) {
+                flush();
+                continue;
+            }
+            const auto [t0, t1] = *clipped;
+            if (point_count == 0 || t0 > 0) {
+                flush();
+                polyline.AddPoint(projector(Interpolate(from, to, t0)));
+                ++point_count;
+            }
+            polyline.AddPoint(projector(Interpolate(from, to, t1)));
+            ++point_count;
+            if (t1 < 1) {
+                flush();
+            }
+        }
+        flush();
+    }
+}
+
+template <typename Container>
+void MapRenderer::DrawBusLabels(const Frame& frame, size_t begin, size_t end, Container& doc) const {
+    const auto& palette = settings_.color_palette;
+    Prototypes prototypes = MakePrototypes();
+    svg::Text& bus_underlayer = prototypes.bus_underlayer;
+    svg::Text& bus_text = prototypes.bus_text;
+    const auto& shown = frame.culling.bus_labels;
+    for (size_t position = begin; position < end; ++position) {
+        const size_t i = frame.BusAt(position);
+        const auto& line = frame.layout.buses[i];
+        const auto& color = palette[i % palette.size()];
+        const transport_catalogue::Stop* stops[] = {line.first_stop, line.last_stop};
+        for (size_t k = 0; k < 2; ++k) {
+            const bool drawn = shown.empty() ? frame.IsVisible(stops[k]) : shown[2 * position + k];
+            if (!drawn) {
+                continue;
+            }
+            const svg::Point label_position = frame.projector(stops[k]->coordinates);
+            doc.Add(bus_underlayer.SetPosition(label_position).SetData(line.bus->name));
+            doc.Add(bus_text.SetPosition(label_position).SetData(line.bus->name).SetFillColor(color));
+        }
+    }
+}
+
+template <typename Container>
+void MapRenderer::DrawStopPoints(const Frame& frame, size_t begin, size_t end, Container& doc) const {
+    Prototypes prototypes = MakePrototypes();
+    svg::Circle& circle = prototypes.stop_point;
+    const auto& shown = frame.culling.stops;
+    for (size_t position = begin; position < end; ++position) {
+        if (shown.empty() || shown[position]) {
+            doc.Add(circle.SetCenter(frame.projector(frame.StopAt(position).coordinates)));
+        }
+    }
+}
+
+template <typename Container>
+void MapRenderer::DrawStopLabels(const Frame& frame, size_t begin, size_t end, Container& doc) const {
+    Prototypes prototypes = MakePrototypes();
+    svg::Text& stop_underlayer = prototypes.stop_underlayer;
+    svg::Text& stop_text = prototypes.stop_text;
+    const auto& shown = frame.culling.stop_labels;
+    for (size_t position = begin; position < end; ++position) {
+        if (!shown.empty() && !shown[position]) {
+            continue;
+        }
+        const auto& stop = frame.StopAt(position);
+        const svg::Point label_position = frame.projector(stop.coordinates);
+        doc.Add(stop_underlayer.SetPosition(label_position).SetData(stop.name));
+        doc.Add(stop_text.SetPosition(label_position).SetData(stop.name));
+    }
+}
+
+}  // namespace renderer
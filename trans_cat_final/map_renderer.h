@@ -1,12 +1,20 @@
 #pragma once
 #include "geo.h"
+#include "spatial_index.h"
 #include "svg.h"
 #include "transport_catalogue.h"
 #include <string>
 #include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <cstdlib>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 inline const double EPSILON = 1e-6;
@@ -66,6 +74,11 @@ public:
         }
     }
 
+    // Сколько единиц изображения приходится на градус (одинаково по обеим осям)
+    double GetScale() const {
+        return zoom_coeff_;
+    }
+
     // Проецирует широту и долготу в координаты внутри SVG-изображения
     svg::Point operator()(transport_catalogue::Coordinates coords) const {
         return {
@@ -74,9 +87,346 @@ public:
         };
     }
 
+    bool operator==(const SphereProjector& other) const {
+        return padding_ == other.padding_ && min_lon_ == other.min_lon_
+            && max_lat_ == other.max_lat_ && zoom_coeff_ == other.zoom_coeff_;
+    }
+    bool operator!=(const SphereProjector& other) const {
+        return !(*this == other);
+    }
+
 private:
     double padding_;
     double min_lon_ = 0;
     double max_lat_ = 0;
     double zoom_coeff_ = 0;
 };
+
+namespace renderer {
+
+struct RenderSettings {
+    double width = 0;
+    double height = 0;
+    double padding = 0;
+    double line_width = 0;
+    double stop_radius = 0;
+    int bus_label_font_size = 0;
+    svg::Point bus_label_offset;
+    int stop_label_font_size = 0;
+    svg::Point stop_label_offset;
+    svg::Color underlayer_color;
+    double underlayer_width = 0;
+    std::vector<svg::Color> color_palette;
+};
+// Настройки сравниваются целиком: по ним видно, что готовую карту пора перерисовать
+bool operator==(const RenderSettings& lhs, const RenderSettings& rhs);
+inline bool operator!=(const RenderSettings& lhs, const RenderSettings& rhs) {
+    return !(lhs == rhs);
+}
+
+// Как карта попадает в поток
+enum class RenderMode {
+    DOCUMENT,  // объекты собираются в svg::Document и выводятся в конце
+    STREAM,    // каждый объект выводится сразу, как только построен
+    COMPACT,   // объекты собираются по значению в svg::CompactDocument
+};
+
+// Как выводится карта; на изображение не влияет
+struct OutputOptions {
+    RenderMode mode = RenderMode::DOCUMENT;
+    // Формат координат и размеров
+    svg::NumberFormat number_format;
+    // CLASSES: одинаковое оформление выносится в CSS-классы. В режиме
+    // STREAM объекты выводятся сразу, и атрибуты остаются в элементах
+    svg::StyleMode style_mode = svg::StyleMode::INLINE;
+    // Слои и куски слоёв рисуются столькими потоками (0 — по числу ядер)
+    // в отдельные строки и склеиваются по порядку. В режиме CLASSES классы
+    // нумеруются по порядку появления, поэтому карта рисуется в одном потоке
+    size_t thread_count = 1;
+};
+
+// Упрощение карты при мелком масштабе. Меняет изображение, по умолчанию выключено
+struct DetailSettings {
+    // Допустимое отклонение упрощённой ломаной от исходной, в единицах
+    // изображения; 0 — ломаные выводятся со всеми вершинами
+    double tolerance = 0;
+    // Кружки остановок и подписи, которые наложились бы на уже нарисованные,
+    // пропускаются; у остановки без кружка нет и подписи
+    bool cull_overlaps = false;
+};
+
+// Автобусы и остановки карты в порядке вывода, остановки уже найдены
+// в каталоге. Ломаные всех автобусов лежат подряд в одном массиве path_stops
+struct MapLayout {
+    struct BusLine {
+        const transport_catalogue::Bus* bus = nullptr;
+        // Ломаная — path_stops[path_begin, path_end): прямой путь и, у
+        // некольцевого маршрута, обратный
+        size_t path_begin = 0;
+        size_t path_end = 0;
+        // Остановки, у которых подписывается название автобуса
+        const transport_catalogue::Stop* first_stop = nullptr;
+        const transport_catalogue::Stop* last_stop = nullptr;
+    };
+
+    explicit MapLayout(const transport_catalogue::TransportCatalogue& catalogue);
+
+    // Все автобусы по имени: номер в этом списке задаёт цвет
+    std::vector<BusLine> buses;
+    std::vector<const transport_catalogue::Stop*> path_stops;
+    // Остановки маршрутов по имени
+    std::vector<const transport_catalogue::Stop*> stops;
+};
+
+// Ломаные автобусов после упрощения: у layout.buses[i] остались вершины
+// path_stops[path_begin + kept[k]] для k из [begin[i], begin[i + 1])
+struct SimplifiedPaths {
+    std::vector<size_t> begin;
+    std::vector<uint32_t> kept;
+};
+// Упрощает все ломаные (Дуглас — Пекер) с отклонением не больше tolerance
+// градусов. У некольцевого маршрута остаётся только прямой путь
+SimplifiedPaths SimplifyPaths(const MapLayout& layout, double tolerance);
+
+// Плитка пирамиды: на уровне z квадрат всей сети делится на 2^z x 2^z
+// плиток, x растёт на восток, y — на юг
+struct TileId {
+    static constexpr int MAX_ZOOM = 24;
+
+    int z = 0;
+    uint32_t x = 0;
+    uint32_t y = 0;
+
+    // Уровень не больше MAX_ZOOM, плитка внутри него
+    bool IsValid() const {
+        return z >= 0 && z <= MAX_ZOOM && x < (uint64_t{1} << z) && y < (uint64_t{1} << z);
+    }
+};
+
+// Раскладка карты и сетки для поиска того, что видно в заданной области.
+// Не зависит от настроек отрисовки, строится один раз на версию каталога
+class MapIndex {
+public:
+    explicit MapIndex(const transport_catalogue::TransportCatalogue& catalogue);
+
+    const MapLayout& GetLayout() const { return layout_; }
+    // Рамка всех остановок маршрутов
+    const spatial::BoundingBox& GetBounds() const { return bounds_; }
+    // Номера автобусов (в layout.buses), у которых участок ломаной может
+    // задевать area, и остановок (в layout.stops) внутри area; по возрастанию
+    std::vector<uint32_t> FindBuses(const spatial::BoundingBox& area) const;
+    std::vector<uint32_t> FindStops(const spatial::BoundingBox& area) const;
+    // Упрощённые ломаные, посчитанные один раз на каждое значение tolerance.
+    // Рисующий округляет масштаб до уровня, так что значений немного
+    std::shared_ptr<const SimplifiedPaths> GetSimplifiedPaths(double tolerance) const;
+    // Квадрат плитки. Плитка уровня 0 — рамка сети, дополненная до
+    // квадрата (в градусах) с тем же центром
+    spatial::BoundingBox GetTileArea(TileId tile) const;
+    // Сторона плитки уровня 0 в градусах
+    double GetTileSide() const { return tile_side_; }
+    // Самое длинное название автобуса или остановки, в символах:
+    // насколько далеко подпись может выступать за свою точку
+    size_t GetMaxLabelLength() const { return max_label_length_; }
+
+private:
+    static constexpr size_t MAX_SIMPLIFIED = 32;
+
+    MapLayout layout_;
+    spatial::BoundingBox bounds_;
+    double tile_side_ = 0;
+    size_t max_label_length_ = 0;
+    spatial::GridIndex<uint32_t> bus_grid_;
+    spatial::GridIndex<uint32_t> stop_grid_;
+    mutable std::mutex simplified_mutex_;
+    mutable std::map<double, std::shared_ptr<const SimplifiedPaths>> simplified_;
+};
+
+// Куски всей карты, которые переживают перерисовку: точки остановок
+// в проекции и SVG-фрагменты ломаной и подписей каждого автобуса. Автобус
+// перерисовывается, только если поменялись он сам, его остановки, цвет
+// или проекция. Потокобезопасность обеспечивает владелец
+class MapCache {
+public:
+    // Сколько автобусов перерисовал последний MapRenderer::Render
+    size_t GetRenderedBusCount() const {
+        return rendered_bus_count_;
+    }
+
+private:
+    friend class MapRenderer;
+
+    struct BusEntry {
+        // Ломаная: прямой путь, затем обратный; остановки прямого пути — первые forward_size
+        std::vector<const transport_catalogue::Stop*> path;
+        size_t forward_size = 0;
+        const transport_catalogue::Stop* first_stop = nullptr;
+        const transport_catalogue::Stop* last_stop = nullptr;
+        // Номер цвета в палитре, с которым нарисованы фрагменты; NOT_RENDERED — не нарисованы
+        size_t color = NOT_RENDERED;
+        std::string line;
+        std::string labels;
+        // Номер перерисовки, в которой автобус был в каталоге
+        uint64_t generation = 0;
+    };
+    static constexpr size_t NOT_RENDERED = static_cast<size_t>(-1);
+
+    // Точка остановки в текущей проекции, считается один раз
+    svg::Point Project(const transport_catalogue::Stop* stop);
+
+    // Настройки, с которыми нарисованы фрагменты; nullopt — ещё ничего не нарисовано
+    std::optional<RenderSettings> settings_;
+    svg::NumberFormat number_format_;
+    uint64_t stop_version_ = 0;
+    uint64_t generation_ = 0;
+    std::optional<SphereProjector> projector_;
+    std::unordered_map<const transport_catalogue::Stop*, svg::Point> points_;
+    // Заменённый в каталоге автобус — это новый объект и новая запись
+    std::unordered_map<const transport_catalogue::Bus*, BusEntry> buses_;
+    // Остановки маршрутов по имени и их слои карты
+    std::vector<const transport_catalogue::Stop*> stops_;
+    std::string stop_points_;
+    std::string stop_labels_;
+    size_t rendered_bus_count_ = 0;
+};
+
+// Область просмотра: прямоугольник либо центр и масштаб
+struct Viewport {
+    std::optional<spatial::BoundingBox> box;
+    transport_catalogue::Coordinates center{0, 0};
+    // 0 — охват всей сети, каждая следующая единица уменьшает его вдвое
+    double zoom = 0;
+
+    // Прямоугольник области для сети с рамкой bounds
+    spatial::BoundingBox Resolve(const spatial::BoundingBox& bounds) const;
+};
+
+// Рисует карту маршрутов каталога в SVG по настройкам отрисовки
+class MapRenderer {
+public:
+    MapRenderer() = default;
+    explicit MapRenderer(RenderSettings settings, OutputOptions options = {}, DetailSettings detail = {})
+        : settings_(std::move(settings)), options_(options), detail_(detail) {}
+
+    const RenderSettings& GetSettings() const { return settings_; }
+    void Render(const transport_catalogue::TransportCatalogue& catalogue, std::ostream& output) const;
+    // Дописывает карту в конец output
+    void Render(const transport_catalogue::TransportCatalogue& catalogue, std::string& output) const;
+    // То же, но фрагменты автобусов и остановок берутся из cache и обновляются
+    // в нём. Когда объекты зависят друг от друга (CSS-классы, упрощение,
+    // прореживание), карта рисуется целиком, без кеша
+    void Render(const transport_catalogue::TransportCatalogue& catalogue, MapCache& cache,
+                std::string& output) const;
+    void Render(const transport_catalogue::TransportCatalogue& catalogue, MapCache& cache,
+                std::ostream& output) const;
+    // Дописывает в output только видимую в area часть карты: проекция
+    // вписывает в холст саму область, ломаные обрезаются по её границе.
+    // Упрощённые ломаные берутся из index для ближайшего более крупного
+    // уровня масштаба (каждый уровень вдвое крупнее всей карты)
+    void Render(const MapIndex& index, const spatial::BoundingBox& area, std::string& output) const;
+    void Render(const MapIndex& index, const spatial::BoundingBox& area, std::ostream& output) const;
+    // Дописывает в output плитку: отдельный SVG с холстом size x size.
+    // Выбираются только объекты, задевающие плитку, поэтому цена не зависит
+    // от размера сети. Кружки и подписи у края рисуются в обеих соседних
+    // плитках и сходятся на стыке; при detail_.cull_overlaps прореживание
+    // у стыка может различаться. false — на плитке ничего нет
+    // (в output всё равно выводится пустой холст)
+    bool RenderTile(const MapIndex& index, TileId tile, double size, std::string& output) const;
+    bool RenderTile(const MapIndex& index, TileId tile, double size, std::ostream& output) const;
+
+private:
+    // Что рисовать, если не всю карту: номера автобусов и остановок
+    // раскладки и область, по которой обрезаются ломаные. canvas —
+    // холст, по которому обрезается изображение (у плиток)
+    struct Selection {
+        spatial::BoundingBox area;
+        std::vector<uint32_t> buses;
+        std::vector<uint32_t> stops;
+        std::optional<svg::Point> canvas;
+    };
+
+    // Слои карты в порядке вывода
+    enum class Layer {
+        BUS_LINES,
+        BUS_LABELS,
+        STOP_POINTS,
+        STOP_LABELS,
+    };
+
+    // Что пропускается при detail_.cull_overlaps, по номерам в порядке вывода;
+    // пустые векторы — рисуется всё. Считается заранее и одним потоком:
+    // что видно, зависит от всего, что нарисовано раньше
+    struct Culling {
+        // По две подписи на автобус: у первой и у последней остановки
+        std::vector<char> bus_labels;
+        std::vector<char> stops;
+        std::vector<char> stop_labels;
+    };
+
+    // Что и в какой проекции рисуется. selection == nullptr — вся карта,
+    // paths == nullptr — ломаные без упрощения
+    struct Frame {
+        const MapLayout& layout;
+        const SphereProjector& projector;
+        const Selection* selection = nullptr;
+        const SimplifiedPaths* paths = nullptr;
+        Culling culling;
+
+        // Автобусы и остановки по порядку вывода: position — номер в этом порядке
+        size_t BusCount() const;
+        size_t StopCount() const;
+        size_t BusAt(size_t position) const;
+        const transport_catalogue::Stop& StopAt(size_t position) const;
+        // Остановка есть и попадает в область
+        bool IsVisible(const transport_catalogue::Stop* stop) const;
+    };
+
+    // Объекты слоёв с оформлением из настроек: остаётся задать координаты,
+    // текст и цвет. Каждый слой заполняет один и тот же объект, и его
+    // память переиспользуется
+    struct Prototypes {
+        svg::Polyline bus_line;
+        svg::Text bus_underlayer;
+        svg::Text bus_text;
+        svg::Circle stop_point;
+        svg::Text stop_underlayer;
+        svg::Text stop_text;
+    };
+    Prototypes MakePrototypes() const;
+
+    // Output — std::ostream или std::string
+    template <typename Output>
+    void RenderTo(const transport_catalogue::TransportCatalogue& catalogue, Output& output) const;
+    template <typename Output>
+    void RenderTo(const transport_catalogue::TransportCatalogue& catalogue, MapCache& cache, Output& output) const;
+    template <typename Output>
+    void RenderTo(const MapIndex& index, const spatial::BoundingBox& area, Output& output) const;
+    template <typename Output>
+    bool RenderTo(const MapIndex& index, TileId tile, double size, Output& output) const;
+    template <typename Output>
+    void RenderTo(const MapLayout& layout, const SphereProjector& projector, const Selection* selection,
+                  const SimplifiedPaths* paths, Output& output) const;
+    template <typename Output>
+    void RenderParallel(const Frame& frame, size_t thread_count, Output& output) const;
+    Culling Cull(const Frame& frame) const;
+    // Добавляет объекты карты в doc (svg::Document, svg::StreamDocument,
+    // svg::CompactDocument или svg::Fragment)
+    template <typename Container>
+    void Draw(const Frame& frame, Container& doc) const;
+    // Объекты слоя для автобусов или остановок с номерами из [begin, end)
+    template <typename Container>
+    void DrawLayer(const Frame& frame, Layer layer, size_t begin, size_t end, Container& doc) const;
+    template <typename Container>
+    void DrawBusLines(const Frame& frame, size_t begin, size_t end, Container& doc) const;
+    template <typename Container>
+    void DrawBusLabels(const Frame& frame, size_t begin, size_t end, Container& doc) const;
+    template <typename Container>
+    void DrawStopPoints(const Frame& frame, size_t begin, size_t end, Container& doc) const;
+    template <typename Container>
+    void DrawStopLabels(const Frame& frame, size_t begin, size_t end, Container& doc) const;
+
+    RenderSettings settings_;
+    OutputOptions options_;
+    DetailSettings detail_;
+};
+
+}  // namespace renderer
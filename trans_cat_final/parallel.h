@@ -0,0 +1,232 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace parallel {
+
+// Число потоков по умолчанию — по числу аппаратных ядер
+inline size_t DefaultThreadCount() {
+    return std::max<size_t>(1, std::thread::hardware_concurrency());
+}
+
+// Потоки, которые присоединяются при выходе из области видимости,
+// в том числе при исключении
+class ThreadGroup {
+public:
+    ThreadGroup() = default;
+    ThreadGroup(const ThreadGroup&) = delete;
+    ThreadGroup& operator=(const ThreadGroup&) = delete;
+    ~ThreadGroup() {
+        Join();
+    }
+
+    template <typename Func>
+    void Start(Func func) {
+        threads_.emplace_back(std::move(func));
+    }
+
+    void Join() {
+        for (auto& thread : threads_) {
+            if (thread.joinable()) {
+                thread.join();
+            }
+        }
+        threads_.clear();
+    }
+
+private:
+    std::vector<std::thread> threads_;
+};
+
+// Очередь фиксированной ёмкости между стадиями конвейера: Push ждёт,
+// пока в очереди не появится место. После Close новые элементы
+// не принимаются, а Pop возвращает nullopt, когда очередь опустеет
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity_(std::max<size_t>(1, capacity)) {}
+
+    // false — очередь закрыта, элемент не добавлен
+    bool Push(T value) {
+        std::unique_lock lock(mutex_);
+        not_full_.wait(lock, [this] {
+            return closed_ || items_.size() < capacity_;
+        });
+        if (closed_) {
+            return false;
+        }
+        items_.push_back(std::move(value));
+        not_empty_.notify_one();
+        return true;
+    }
+
+    std::optional<T> Pop() {
+        std::unique_lock lock(mutex_);
+        not_empty_.wait(lock, [this] {
+            return closed_ || !items_.empty();
+        });
+        if (items_.empty()) {
+            return std::nullopt;
+        }
+        T value = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return value;
+    }
+
+    void Close() {
+        std::lock_guard guard(mutex_);
+        closed_ = true;
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+
+private:
+    const size_t capacity_;
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::deque<T> items_;
+    bool closed_ = false;
+};
+
+// Восстанавливает порядок результатов, посчитанных в разных потоках.
+// Put(i, ...) ждёт, пока i не попадёт в окно [next, next + window),
+// поэтому в буфере одновременно не больше window результатов.
+// Take отдаёт результаты строго по порядку индексов
+template <typename T>
+class ReorderBuffer {
+public:
+    explicit ReorderBuffer(size_t window)
+        : slots_(std::max<size_t>(1, window)) {}
+
+    void Put(size_t index, T value) {
+        std::unique_lock lock(mutex_);
+        WaitForWindow(lock, index);
+        if (error_) {
+            return;
+        }
+        slots_[index % slots_.size()] = std::move(value);
+        slot_ready_.notify_all();
+    }
+
+    // Ждёт, пока index не попадёт в окно: после этого Put(index, ...)
+    // не ждёт. Производитель, который вызывает его до того, как отдать
+    // работу, держит в обороте не больше window заданий. false — работа прервана
+    bool WaitForSlot(size_t index) {
+        std::unique_lock lock(mutex_);
+        WaitForWindow(lock, index);
+        return !error_;
+    }
+
+    // Всего результатов будет count: после него Take вернёт nullopt
+    void SetCount(size_t count) {
+        std::lock_guard guard(mutex_);
+        count_ = count;
+        slot_ready_.notify_all();
+    }
+
+    // Прерывает работу: Take бросит error, Put перестанет ждать
+    void Fail(std::exception_ptr error) {
+        std::lock_guard guard(mutex_);
+        if (!error_) {
+            error_ = error;
+        }
+        slot_ready_.notify_all();
+        slot_free_.notify_all();
+    }
+
+    std::optional<T> Take() {
+        std::unique_lock lock(mutex_);
+        slot_ready_.wait(lock, [this] {
+            return error_ || next_ == count_ || slots_[next_ % slots_.size()].has_value();
+        });
+        if (error_) {
+            std::rethrow_exception(error_);
+        }
+        if (next_ == count_) {
+            return std::nullopt;
+        }
+        auto& slot = slots_[next_ % slots_.size()];
+        T value = std::move(*slot);
+        slot.reset();
+        ++next_;
+        slot_free_.notify_all();
+        return value;
+    }
+
+private:
+    void WaitForWindow(std::unique_lock<std::mutex>& lock, size_t index) {
+        slot_free_.wait(lock, [this, index] {
+            return error_ || index < next_ + slots_.size();
+        });
+    }
+
+    std::mutex mutex_;
+    std::condition_variable slot_ready_;
+    std::condition_variable slot_free_;
+    std::vector<std::optional<T>> slots_;
+    size_t next_ = 0;
+    size_t count_ = static_cast<size_t>(-1);
+    std::exception_ptr error_;
+};
+
+// Сколько результатов OrderedForEach на один рабочий поток может ждать
+// своей очереди в consume
+inline constexpr size_t ORDERED_WINDOW_PER_THREAD = 4;
+
+// Вызывает produce(i) для i из [0, count) на thread_count рабочих потоках
+// (индексы раздаются по одному, кто освободился — берёт следующий).
+// Вызывающий поток получает результаты через consume(i, result) строго
+// в порядке индексов, не дожидаясь окончания всей работы. Поток не берёт
+// индекс дальше окна ORDERED_WINDOW_PER_THREAD * thread_count от ещё
+// не отданного в consume, поэтому память не растёт с count, даже если
+// один результат считается долго.
+// Исключение из produce пробрасывается из OrderedForEach
+template <typename Result, typename Produce, typename Consume>
+void OrderedForEach(size_t count, size_t thread_count, Produce produce, Consume consume) {
+    const size_t worker_count = std::min(thread_count, count);
+    ReorderBuffer<Result> results(ORDERED_WINDOW_PER_THREAD * std::max<size_t>(1, worker_count));
+    results.SetCount(count);
+    std::atomic<size_t> next_index = 0;
+
+    // Объявлен после results: при выходе потоки присоединяются раньше,
+    // чем буфер будет разрушен
+    ThreadGroup workers;
+    for (size_t t = 0; t < worker_count; ++t) {
+        workers.Start([&] {
+            for (size_t i = next_index++; i < count; i = next_index++) {
+                if (!results.WaitForSlot(i)) {
+                    return;
+                }
+                try {
+                    results.Put(i, produce(i));
+                } catch (...) {
+                    results.Fail(std::current_exception());
+                    return;
+                }
+            }
+        });
+    }
+
+    try {
+        for (size_t i = 0; i < count; ++i) {
+            consume(i, std::move(*results.Take()));
+        }
+    } catch (...) {
+        // Будит потоки, ждущие места в окне: они завершатся, не беря новых индексов
+        results.Fail(std::current_exception());
+        throw;
+    }
+}
+
+}  // namespace parallel
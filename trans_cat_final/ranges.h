@@ -1,9 +1,11 @@
 #pragma once
 
+#include <cstddef>
 #include <iterator>
 #include <string_view>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 namespace ranges {
 
@@ -22,6 +24,12 @@ public:
     It end() const {
         return end_;
     }
+    size_t size() const {
+        return static_cast<size_t>(std::distance(begin_, end_));
+    }
+    bool empty() const {
+        return begin_ == end_;
+    }
 
 private:
     It begin_;
@@ -33,4 +41,10 @@ auto AsRange(const C& container) {
     return Range{container.begin(), container.end()};
 }
 
+// Непрерывный диапазон элементов вектора (аналог std::span)
+template <typename T>
+Range<const T*> AsSpan(const std::vector<T>& container) {
+    return Range<const T*>{container.data(), container.data() + container.size()};
+}
+
 }  // namespace ranges
\ No newline at end of file
@@ -1,9 +1,133 @@
 #include "request_handler.h"
+#include "parallel.h"
 
-/*
- * Здесь можно было бы разместить код обработчика запросов к базе, содержащего логику, которую не
- * хотелось бы помещать ни в transport_catalogue, ни в json reader.
- *
- * Если вы затрудняетесь выбрать, что можно было бы поместить в этот файл,
- * можете оставить его пустым.
- */
\ No newline at end of file
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace request_handler {
+
+void QueryBatch::Add(Query query) {
+    std::visit([this](auto&& item) {
+        using T = std::decay_t<decltype(item)>;
+        if constexpr (std::is_same_v<T, BusQuery>) {
+            order.emplace_back(QueryType::BUS, buses.size());
+            buses.push_back(std::move(item));
+        } else if constexpr (std::is_same_v<T, StopQuery>) {
+            order.emplace_back(QueryType::STOP, stops.size());
+            stops.push_back(std::move(item));
+        } else if constexpr (std::is_same_v<T, RouteQuery>) {
+            order.emplace_back(QueryType::ROUTE, routes.size());
+            routes.push_back(std::move(item));
+        } else {
+            order.emplace_back(QueryType::MAP, maps.size());
+            maps.push_back(std::move(item));
+        }
+    }, std::move(query));
+}
+
+RequestHandler::RequestHandler(const transport_catalogue::TransportCatalogue& db,
+                               const renderer::MapRenderer& renderer, RouterProvider router)
+    : db_(db), renderer_(renderer), router_(std::move(router)) {
+}
+
+std::optional<BusStat> RequestHandler::GetBusStat(std::string_view bus_name) const {
+    const transport_catalogue::Bus* bus = db_.FindBus(bus_name);
+    if (!bus) {
+        return std::nullopt;
+    }
+    transport_catalogue::BusRouteInfo bus_inf = db_.GetBusRoute(bus_name);
+    size_t stop_count = bus->is_roundtrip ? bus_inf.stops_on_route : bus_inf.stops_on_route * 2 - 1;
+    return BusStat{bus_inf.curvature, bus_inf.fact_length, static_cast<int>(stop_count),
+                   static_cast<int>(bus_inf.unique_stops)};
+}
+
+std::optional<StopBuses> RequestHandler::GetBusesByStop(std::string_view stop_name) const {
+    if (!db_.FindStop(stop_name)) {
+        return std::nullopt;
+    }
+    const auto& buses = db_.GetBusesByStop(stop_name);
+    StopBuses result(buses.begin(), buses.end());
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+std::optional<transport::RouteInfo> RequestHandler::FindRoute(std::string_view from, std::string_view to) const {
+    return router_()->FindRoute(from, to);
+}
+
+void RequestHandler::RenderMap(std::ostream& output) const {
+    renderer_.Render(db_, output);
+}
+
+std::vector<std::optional<BusStat>> RequestHandler::GetBusStats(Span<BusQuery> queries) const {
+    std::vector<std::optional<BusStat>> result;
+    result.reserve(queries.size());
+    for (const BusQuery& query : queries) {
+        result.push_back(GetBusStat(query.name));
+    }
+    return result;
+}
+
+std::vector<std::optional<StopBuses>> RequestHandler::GetBusesByStops(Span<StopQuery> queries) const {
+    std::vector<std::optional<StopBuses>> result;
+    result.reserve(queries.size());
+    for (const StopQuery& query : queries) {
+        result.push_back(GetBusesByStop(query.name));
+    }
+    return result;
+}
+
+std::vector<std::optional<transport::RouteInfo>> RequestHandler::FindRoutes(Span<RouteQuery> queries,
+                                                                            size_t thread_count) const {
+    using Routes = std::vector<std::optional<transport::RouteInfo>>;
+    Routes result(queries.size());
+    if (queries.empty()) {
+        return result;
+    }
+    struct OriginGroup {
+        std::string_view from;
+        std::vector<std::string_view> to;
+        std::vector<size_t> positions;
+    };
+    std::unordered_map<std::string_view, size_t> origin_index;
+    std::vector<OriginGroup> groups;
+    size_t position = 0;
+    for (const RouteQuery& query : queries) {
+        const auto [origin, inserted] = origin_index.emplace(query.from, groups.size());
+        if (inserted) {
+            groups.push_back({query.from, {}, {}});
+        }
+        groups[origin->second].to.push_back(query.to);
+        groups[origin->second].positions.push_back(position++);
+    }
+
+    const auto router = router_();
+    auto store = [&result, &groups](size_t i, Routes&& routes) {
+        for (size_t j = 0; j < routes.size(); ++j) {
+            result[groups[i].positions[j]] = std::move(routes[j]);
+        }
+    };
+    if (thread_count > 1) {
+        parallel::OrderedForEach<Routes>(groups.size(), thread_count,
+            [&router, &groups](size_t i) {
+                return router->FindRoutes(groups[i].from, groups[i].to);
+            },
+            store);
+    } else {
+        for (size_t i = 0; i < groups.size(); ++i) {
+            store(i, router->FindRoutes(groups[i].from, groups[i].to));
+        }
+    }
+    return result;
+}
+
+size_t RequestHandler::CountOrigins(Span<RouteQuery> queries) {
+    std::unordered_set<std::string_view> origins;
+    for (const RouteQuery& query : queries) {
+        origins.insert(query.from);
+    }
+    return origins.size();
+}
+
+}  // namespace request_handler
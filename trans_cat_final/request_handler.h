@@ -1,37 +1,122 @@
 #pragma once
 
+#include "map_renderer.h"
+#include "ranges.h"
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
 /*
- * Здесь можно было бы разместить код обработчика запросов к базе, содержащего логику, которую не
- * хотелось бы помещать ни в transport_catalogue, ни в json reader.
- *
- * В качестве источника для идей предлагаем взглянуть на нашу версию обработчика запросов.
- * Вы можете реализовать обработку запросов способом, который удобнее вам.
- *
- * Если вы затрудняетесь выбрать, что можно было бы поместить в этот файл,
- * можете оставить его пустым.
+ * Обработчик запросов к базе: фасад над каталогом, роутером и визуализатором карты.
+ * Запросы приходят уже разобранными в типизированные структуры, поэтому
+ * здесь нет ничего от JSON, а запросы одного типа обрабатываются пачкой
  */
 
-// Класс RequestHandler играет роль Фасада, упрощающего взаимодействие JSON reader-а
-// с другими подсистемами приложения.
-// См. паттерн проектирования Фасад: https://ru.wikipedia.org/wiki/Фасад_(шаблон_проектирования)
-/*
+namespace request_handler {
+
+struct BusQuery {
+    int id = 0;
+    std::string name;
+};
+
+struct StopQuery {
+    int id = 0;
+    std::string name;
+};
+
+struct RouteQuery {
+    int id = 0;
+    std::string from;
+    std::string to;
+};
+
+struct MapQuery {
+    int id = 0;
+    // Если задана — рисуется только видимая в ней часть карты
+    std::optional<renderer::Viewport> viewport;
+    // Если задана — рисуется плитка пирамиды (запрос Tile)
+    std::optional<renderer::TileId> tile;
+};
+
+using Query = std::variant<BusQuery, StopQuery, RouteQuery, MapQuery>;
+
+enum class QueryType {
+    BUS,
+    STOP,
+    ROUTE,
+    MAP,
+};
+
+// Пакет запросов, разложенный по типам. order хранит исходный порядок:
+// тип каждого запроса и его индекс в векторе своего типа
+struct QueryBatch {
+    std::vector<BusQuery> buses;
+    std::vector<StopQuery> stops;
+    std::vector<RouteQuery> routes;
+    std::vector<MapQuery> maps;
+    std::vector<std::pair<QueryType, size_t>> order;
+
+    void Add(Query query);
+    size_t size() const { return order.size(); }
+    bool empty() const { return order.empty(); }
+};
+
+struct BusStat {
+    double curvature = 0;
+    int route_length = 0;
+    int stop_count = 0;
+    int unique_stop_count = 0;
+};
+
+// Автобусы через остановку в алфавитном порядке
+using StopBuses = std::vector<std::string_view>;
+
+template <typename T>
+using Span = ranges::Range<const T*>;
+
 class RequestHandler {
 public:
-    // MapRenderer понадобится в следующей части итогового проекта
-    RequestHandler(const TransportCatalogue& db, const renderer::MapRenderer& renderer);
+    // Роутер запрашивается только при первом запросе Route: его построение
+    // может быть отложенным. После изменения каталога провайдер отдаёт новый
+    // роутер, а пакет досчитывает на том, который получил
+    using RouterProvider = std::function<std::shared_ptr<const transport::TransportRouter>()>;
+
+    RequestHandler(const transport_catalogue::TransportCatalogue& db,
+                   const renderer::MapRenderer& renderer, RouterProvider router);
 
     // Возвращает информацию о маршруте (запрос Bus)
-    std::optional<BusStat> GetBusStat(const std::string_view& bus_name) const;
+    std::optional<BusStat> GetBusStat(std::string_view bus_name) const;
+    // Возвращает маршруты, проходящие через остановку (запрос Stop)
+    std::optional<StopBuses> GetBusesByStop(std::string_view stop_name) const;
+    std::optional<transport::RouteInfo> FindRoute(std::string_view from, std::string_view to) const;
+    void RenderMap(std::ostream& output) const;
 
-    // Возвращает маршруты, проходящие через
-    const std::unordered_set<BusPtr>* GetBusesByStop(const std::string_view& stop_name) const;
+    // Пакетные версии: i-й ответ относится к i-му запросу
+    std::vector<std::optional<BusStat>> GetBusStats(Span<BusQuery> queries) const;
+    std::vector<std::optional<StopBuses>> GetBusesByStops(Span<StopQuery> queries) const;
+    // Маршруты с общей начальной остановкой считаются одним вызовом
+    // TransportRouter::FindRoutes; группы остановок — на thread_count потоках
+    std::vector<std::optional<transport::RouteInfo>> FindRoutes(Span<RouteQuery> queries,
+                                                                size_t thread_count = 1) const;
 
-    // Этот метод будет нужен в следующей части итогового проекта
-    svg::Document RenderMap() const;
+    // Сколько разных начальных остановок у запросов
+    static size_t CountOrigins(Span<RouteQuery> queries);
 
 private:
     // RequestHandler использует агрегацию объектов "Транспортный Справочник" и "Визуализатор Карты"
-    const TransportCatalogue& db_;
+    const transport_catalogue::TransportCatalogue& db_;
     const renderer::MapRenderer& renderer_;
+    RouterProvider router_;
 };
-*/
\ No newline at end of file
+
+}  // namespace request_handler
@@ -6,7 +6,9 @@
 #include <cassert>
 #include <cstdint>
 #include <iterator>
+#include <functional>
 #include <optional>
+#include <queue>
 #include <stdexcept>
 #include <unordered_map>
 #include <utility>
@@ -114,4 +116,87 @@ std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(Ver
     return RouteInfo{weight, std::move(edges)};
 }
 
+// Дерево кратчайших путей из одной вершины (алгоритм Дейкстры).
+// В отличие от Router не требует квадратичной памяти: строится по запросу
+// и отвечает на маршруты из своей вершины во все остальные
+template <typename Weight>
+class ShortestPathTree {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using RouteInfo = typename Router<Weight>::RouteInfo;
+
+    ShortestPathTree(const Graph& graph, VertexId from);
+
+    VertexId GetSource() const {
+        return from_;
+    }
+    std::optional<RouteInfo> BuildRoute(VertexId to) const;
+    // Сколько памяти занимает дерево, в байтах
+    size_t GetMemoryUsage() const {
+        return sizeof(*this) + routes_internal_data_.capacity() * sizeof(routes_internal_data_[0]);
+    }
+
+private:
+    struct RouteInternalData {
+        Weight weight;
+        std::optional<EdgeId> prev_edge;
+    };
+
+    const Graph& graph_;
+    VertexId from_;
+    std::vector<std::optional<RouteInternalData>> routes_internal_data_;
+};
+
+template <typename Weight>
+ShortestPathTree<Weight>::ShortestPathTree(const Graph& graph, VertexId from)
+    : graph_(graph)
+    , from_(from)
+    , routes_internal_data_(graph.GetVertexCount())
+{
+    using QueueItem = std::pair<Weight, VertexId>;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+    routes_internal_data_.at(from) = RouteInternalData{Weight{}, std::nullopt};
+    queue.push({Weight{}, from});
+    while (!queue.empty()) {
+        const auto [weight, vertex] = queue.top();
+        queue.pop();
+        if (routes_internal_data_[vertex]->weight < weight) {
+            continue;  // Вершина уже обработана с меньшим весом
+        }
+        for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
+            const auto& edge = graph.GetEdge(edge_id);
+            if (edge.weight < Weight{}) {
+                throw std::domain_error("Edges' weights should be non-negative");
+            }
+            const Weight candidate_weight = weight + edge.weight;
+            auto& route_to = routes_internal_data_[edge.to];
+            if (!route_to || candidate_weight < route_to->weight) {
+                route_to = RouteInternalData{candidate_weight, edge_id};
+                queue.push({candidate_weight, edge.to});
+            }
+        }
+    }
+}
+
+template <typename Weight>
+std::optional<typename ShortestPathTree<Weight>::RouteInfo>
+ShortestPathTree<Weight>::BuildRoute(VertexId to) const {
+    const auto& route_internal_data = routes_internal_data_.at(to);
+    if (!route_internal_data) {
+        return std::nullopt;
+    }
+    std::vector<EdgeId> edges;
+    for (std::optional<EdgeId> edge_id = route_internal_data->prev_edge;
+         edge_id;
+         edge_id = routes_internal_data_[graph_.GetEdge(*edge_id).from]->prev_edge)
+    {
+        edges.push_back(*edge_id);
+    }
+    std::reverse(edges.begin(), edges.end());
+
+    return RouteInfo{route_internal_data->weight, std::move(edges)};
+}
+
 }  // namespace graph
\ No newline at end of file
@@ -0,0 +1,392 @@
+#include "server.h"
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <unordered_set>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace server {
+
+using namespace std::literals;
+
+namespace {
+
+// Ответ на один кадр. Ошибка в кадре не останавливает сервер:
+// клиент получает её описание вместо массива ответов
+std::string ProcessFrame(const json_reader::JsonReader& reader, std::string_view frame) {
+    std::istringstream input{std::string(frame)};
+    std::ostringstream output;
+    try {
+        reader.ProcessBatch(input, output);
+    } catch (const std::exception& e) {
+        std::string error;
+        json::Writer(error).StartDict().Key("error_message").Value(e.what()).EndDict();
+        return error;
+    }
+    return std::move(output).str();
+}
+
+bool IsBlank(std::string_view line) {
+    return line.find_first_not_of(" \t\r"sv) == std::string_view::npos;
+}
+
+// Гистограмма по степеням двойки: память постоянна при любом числе замеров
+class LatencyHistogram {
+public:
+    void Add(std::chrono::microseconds latency) {
+        const auto value = static_cast<unsigned long long>(std::max<long long>(latency.count(), 0));
+        size_t bucket = 0;
+        while (bucket + 1 < buckets_.size() && (1ull << bucket) <= value) {
+            ++bucket;
+        }
+        ++buckets_[bucket];
+        ++count_;
+        max_ = std::max(max_, latency);
+    }
+
+    LatencyStats GetStats() const {
+        LatencyStats stats;
+        stats.count = count_;
+        stats.p50 = Percentile(50);
+        stats.p99 = Percentile(99);
+        stats.max = max_;
+        return stats;
+    }
+
+private:
+    std::chrono::microseconds Percentile(size_t percent) const {
+        const size_t rank = (count_ * percent + 99) / 100;
+        size_t seen = 0;
+        for (size_t bucket = 0; bucket < buckets_.size(); ++bucket) {
+            seen += buckets_[bucket];
+            if (seen >= rank && seen > 0) {
+                return std::min(max_, std::chrono::microseconds(1ll << bucket));
+            }
+        }
+        return max_;
+    }
+
+    std::array<size_t, 40> buckets_{};
+    size_t count_ = 0;
+    std::chrono::microseconds max_{0};
+};
+
+}  // namespace
+
+void ServeFrames(const json_reader::JsonReader& reader, std::istream& input, std::ostream& output) {
+    std::string line;
+    while (std::getline(input, line)) {
+        if (IsBlank(line)) {
+            continue;
+        }
+        output << ProcessFrame(reader, line) << '\n';
+        output.flush();
+    }
+}
+
+LatencyStats ServeLines(const json_reader::JsonReader& reader, std::istream& input, std::ostream& output,
+                        size_t flush_every) {
+    using Clock = std::chrono::steady_clock;
+    LatencyHistogram latencies;
+    std::string buffer;
+    size_t pending = 0;
+    std::string line;
+    while (std::getline(input, line)) {
+        if (IsBlank(line)) {
+            continue;
+        }
+        const auto start = Clock::now();
+        const size_t size = buffer.size();
+        try {
+            std::istringstream request_input(line);
+            const json::Document doc = json::Load(request_input);
+            reader.ProcessRequest(doc.GetRoot().AsMap(), buffer);
+        } catch (const std::exception& e) {
+            buffer.resize(size);
+            json::Writer(buffer).StartDict().Key("error_message").Value(e.what()).EndDict();
+        }
+        // Запрос неизвестного типа не даёт ответа и строки вывода
+        if (buffer.size() == size) {
+            continue;
+        }
+        buffer.push_back('\n');
+        latencies.Add(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start));
+        if (++pending >= flush_every) {
+            output.write(buffer.data(), buffer.size());
+            output.flush();
+            buffer.clear();
+            pending = 0;
+        }
+    }
+    output.write(buffer.data(), buffer.size());
+    output.flush();
+    return latencies.GetStats();
+}
+
+#ifdef _WIN32
+
+void ServeUnixSocket(const json_reader::JsonReader&, const std::string&, SocketLimits) {
+    throw std::runtime_error("Unix domain sockets are not supported on this platform");
+}
+
+#else
+
+namespace {
+
+std::runtime_error SystemError(std::string_view what) {
+    return std::runtime_error(std::string(what) + ": "s + std::strerror(errno));
+}
+
+// Закрывает дескриптор при выходе из области видимости
+class FileDescriptor {
+public:
+    explicit FileDescriptor(int fd) : fd_(fd) {}
+    FileDescriptor(const FileDescriptor&) = delete;
+    FileDescriptor& operator=(const FileDescriptor&) = delete;
+    ~FileDescriptor() {
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+    int Get() const {
+        return fd_;
+    }
+
+private:
+    int fd_;
+};
+
+bool SendAll(int fd, std::string_view data) {
+    while (!data.empty()) {
+        const ssize_t sent = send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        data.remove_prefix(static_cast<size_t>(sent));
+    }
+    return true;
+}
+
+// Места для клиентов и сокеты тех, кого сейчас обслуживают. Сокет
+// выписывается до того, как его закроют: иначе ShutdownAll мог бы задеть
+// файл, которому достался тот же номер дескриптора
+class ClientSlots {
+public:
+    explicit ClientSlots(size_t count) : free_(std::max<size_t>(1, count)) {}
+
+    // Ждёт свободного места
+    void Acquire() {
+        std::unique_lock lock(mutex_);
+        released_.wait(lock, [this] {
+            return free_ > 0;
+        });
+        --free_;
+    }
+
+    // Место занял клиент с этим сокетом
+    void Register(int fd) {
+        std::lock_guard guard(mutex_);
+        clients_.insert(fd);
+    }
+
+    // Освобождает место; fd < 0 — клиента на нём так и не зарегистрировали
+    void Release(int fd = -1) {
+        std::lock_guard guard(mutex_);
+        clients_.erase(fd);
+        ++free_;
+        released_.notify_all();
+    }
+
+    // Прерывает обмен со всеми клиентами: их recv и send сразу завершатся
+    void ShutdownAll() {
+        std::lock_guard guard(mutex_);
+        for (const int fd : clients_) {
+            shutdown(fd, SHUT_RDWR);
+        }
+    }
+
+    // Ждёт, пока все клиенты не отпустят места
+    void WaitIdle() {
+        std::unique_lock lock(mutex_);
+        released_.wait(lock, [this] {
+            return clients_.empty();
+        });
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable released_;
+    size_t free_;
+    std::unordered_set<int> clients_;
+};
+
+std::string FrameTooLong(size_t max_frame_bytes) {
+    std::string error;
+    json::Writer(error).StartDict()
+        .Key("error_message").Value("Frame is longer than "s + std::to_string(max_frame_bytes) + " bytes"s)
+        .EndDict();
+    error.push_back('\n');
+    return error;
+}
+
+// Читает кадры клиента, пока тот не закроет соединение или не пришлёт
+// кадр длиннее max_frame_bytes. Сокет закрывает вызывающий
+void ServeClient(const json_reader::JsonReader& reader, int client_fd, size_t max_frame_bytes) {
+    std::string pending;
+    char chunk[64 * 1024];
+    for (;;) {
+        const ssize_t received = recv(client_fd, chunk, sizeof(chunk), 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return;
+        }
+        const size_t scanned = pending.size();
+        pending.append(chunk, static_cast<size_t>(received));
+        size_t frame_start = 0;
+        for (size_t end = pending.find('\n', scanned); end != std::string::npos;
+             end = pending.find('\n', frame_start)) {
+            const std::string_view frame = std::string_view(pending).substr(frame_start, end - frame_start);
+            frame_start = end + 1;
+            if (frame.size() > max_frame_bytes) {
+                SendAll(client_fd, FrameTooLong(max_frame_bytes));
+                return;
+            }
+            if (IsBlank(frame)) {
+                continue;
+            }
+            std::string response = ProcessFrame(reader, frame);
+            response.push_back('\n');
+            if (!SendAll(client_fd, response)) {
+                return;
+            }
+        }
+        pending.erase(0, frame_start);
+        // Недочитанный кадр уже длиннее предела: дальше его не копим
+        if (pending.size() > max_frame_bytes) {
+            SendAll(client_fd, FrameTooLong(max_frame_bytes));
+            return;
+        }
+    }
+}
+
+// Убирает сокет, оставшийся от прошлого запуска. Обычный файл или
+// каталог по этому пути не трогаем
+void RemoveStaleSocket(const std::string& path) {
+    struct stat status{};
+    if (lstat(path.c_str(), &status) < 0) {
+        if (errno == ENOENT) {
+            return;
+        }
+        throw SystemError("lstat "s + path);
+    }
+    if (!S_ISSOCK(status.st_mode)) {
+        throw std::invalid_argument("Not a socket, refusing to replace: "s + path);
+    }
+    if (unlink(path.c_str()) < 0) {
+        throw SystemError("unlink "s + path);
+    }
+}
+
+// Пауза перед следующим accept, когда у процесса или системы кончились
+// дескрипторы, память или потоки: ошибка временная, сервер продолжает работу
+constexpr auto ACCEPT_BACKOFF = std::chrono::milliseconds(100);
+
+bool IsTemporaryAcceptError(int error) {
+    return error == EMFILE || error == ENFILE || error == ENOBUFS || error == ENOMEM;
+}
+
+// Принимает клиентов, пока accept не вернёт постоянную ошибку
+void AcceptClients(const json_reader::JsonReader& reader, int listener,
+                   const std::shared_ptr<ClientSlots>& slots, size_t max_frame_bytes) {
+    for (;;) {
+        // Пока все места заняты, новые клиенты ждут в очереди listen
+        slots->Acquire();
+        const int client = accept(listener, nullptr, nullptr);
+        if (client < 0) {
+            const int error = errno;
+            slots->Release();
+            if (error == EINTR || error == ECONNABORTED) {
+                continue;
+            }
+            if (IsTemporaryAcceptError(error)) {
+                std::this_thread::sleep_for(ACCEPT_BACKOFF);
+                continue;
+            }
+            errno = error;
+            throw SystemError("accept"sv);
+        }
+        slots->Register(client);
+        try {
+            std::thread([&reader, client, slots, max_frame_bytes] {
+                ServeClient(reader, client, max_frame_bytes);
+                slots->Release(client);
+                close(client);
+            }).detach();
+        } catch (const std::system_error&) {
+            // Поток не создался: клиенту отказываем, как при нехватке дескрипторов
+            slots->Release(client);
+            close(client);
+            std::this_thread::sleep_for(ACCEPT_BACKOFF);
+        }
+    }
+}
+
+}  // namespace
+
+void ServeUnixSocket(const json_reader::JsonReader& reader, const std::string& path, SocketLimits limits) {
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::invalid_argument("Socket path is too long: "s + path);
+    }
+    address.sun_family = AF_UNIX;
+    path.copy(address.sun_path, path.size());
+
+    const FileDescriptor listener(socket(AF_UNIX, SOCK_STREAM, 0));
+    if (listener.Get() < 0) {
+        throw SystemError("socket"sv);
+    }
+    RemoveStaleSocket(path);
+    if (bind(listener.Get(), reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0) {
+        throw SystemError("bind"sv);
+    }
+    if (listen(listener.Get(), SOMAXCONN) < 0) {
+        throw SystemError("listen"sv);
+    }
+    // Потоки клиентов не присоединяются, а счётчик мест держат до конца,
+    // поэтому он общий с ними
+    const auto slots = std::make_shared<ClientSlots>(limits.max_clients);
+    try {
+        AcceptClients(reader, listener.Get(), slots, limits.max_frame_bytes);
+    } catch (...) {
+        // Пока хоть один клиент читает ридер, выходить нельзя: его
+        // разрушат сразу после нашего возврата
+        slots->ShutdownAll();
+        slots->WaitIdle();
+        throw;
+    }
+}
+
+#endif
+
+}  // namespace server
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "json_reader.h"
+
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+/*
+ * Режим сервера: базовые данные загружаются один раз, после чего
+ * ридер отвечает на пакеты stat_requests. Кадр — одна строка с JSON-документом
+ * пакета, ответ — одна строка с массивом ответов в обычном формате
+ */
+
+namespace server {
+
+// Кадры читаются из input до конца потока, ответы пишутся в output
+void ServeFrames(const json_reader::JsonReader& reader, std::istream& input, std::ostream& output);
+
+// Время ответа на запрос в режиме JSON Lines: от чтения строки
+// до готового ответа, без ожидания сброса буфера вывода
+struct LatencyStats {
+    size_t count = 0;
+    // Оценки сверху: точность — до степени двойки микросекунд
+    std::chrono::microseconds p50{0};
+    std::chrono::microseconds p99{0};
+    std::chrono::microseconds max{0};
+};
+
+// JSON Lines: один запрос stat_requests на строку входа, один ответ на строку
+// вывода. Вывод сбрасывается после каждых flush_every ответов и в конце потока.
+// Память не зависит от длины потока
+LatencyStats ServeLines(const json_reader::JsonReader& reader, std::istream& input, std::ostream& output,
+                        size_t flush_every = 1);
+
+// Ограничения сервера на сокете
+struct SocketLimits {
+    // Одновременно обслуживаемых клиентов; остальные ждут в очереди listen
+    size_t max_clients = 64;
+    // Кадр длиннее получает ошибку, и соединение закрывается
+    size_t max_frame_bytes = size_t{64} << 20;
+};
+
+// Принимает клиентов на локальном (Unix domain) сокете path, каждого
+// обслуживает отдельный поток. Существующий сокет по этому пути
+// заменяется, любой другой файл — ошибка. Нехватка дескрипторов и потоков
+// пережидается. Возвращается только при постоянной ошибке сокета — разорвав
+// соединения и дождавшись, пока потоки клиентов закончат работу с ридером
+void ServeUnixSocket(const json_reader::JsonReader& reader, const std::string& path, SocketLimits limits = {});
+
+}  // namespace server
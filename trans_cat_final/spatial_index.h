@@ -0,0 +1,180 @@
+#pragma once
+
+#include "geo.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace spatial {
+
+using transport_catalogue::Coordinates;
+
+// Прямоугольник в координатах широта/долгота
+struct BoundingBox {
+    double min_lat = 0;
+    double min_lng = 0;
+    double max_lat = 0;
+    double max_lng = 0;
+
+    static BoundingBox Of(Coordinates point) {
+        return {point.lat, point.lng, point.lat, point.lng};
+    }
+
+    void Extend(Coordinates point) {
+        min_lat = std::min(min_lat, point.lat);
+        min_lng = std::min(min_lng, point.lng);
+        max_lat = std::max(max_lat, point.lat);
+        max_lng = std::max(max_lng, point.lng);
+    }
+
+    bool Contains(Coordinates point) const {
+        return min_lat <= point.lat && point.lat <= max_lat
+            && min_lng <= point.lng && point.lng <= max_lng;
+    }
+
+    bool Intersects(const BoundingBox& other) const {
+        return min_lat <= other.max_lat && other.min_lat <= max_lat
+            && min_lng <= other.max_lng && other.min_lng <= max_lng;
+    }
+};
+
+// Равномерная сетка над прямоугольником bounds. Элемент записывается во все
+// ячейки, которые задевает его рамка (отрезок — в ячейки вдоль себя), а запрос перебирает только ячейки,
+// задетые прямоугольником запроса: его цена зависит от того, сколько
+// элементов рядом, а не от их общего числа
+template <typename Value>
+class GridIndex {
+public:
+    // Сторона сетки для count точек: в среднем по точке на ячейку
+    static size_t SideForPoints(size_t count) {
+        return static_cast<size_t>(std::sqrt(static_cast<double>(count)));
+    }
+    // Сторона сетки для отрезков общей длины length (в долях стороны bounds
+    // по каждой оси): записей в ячейках выходит не больше 8 на отрезок
+    static size_t SideForSegments(size_t count, double length) {
+        const double side = std::sqrt(static_cast<double>(count));
+        return static_cast<size_t>(length > 0 ? std::min(side, 8 * count / length) : side);
+    }
+
+    GridIndex() = default;
+
+    // Сетка side x side ячеек
+    GridIndex(const BoundingBox& bounds, size_t side)
+        : bounds_(bounds) {
+        rows_ = cols_ = std::clamp<size_t>(side, 1, MAX_SIDE);
+        cell_lat_ = (bounds_.max_lat - bounds_.min_lat) / rows_;
+        cell_lng_ = (bounds_.max_lng - bounds_.min_lng) / cols_;
+        cells_.resize(rows_ * cols_);
+    }
+
+    void Insert(const BoundingBox& box, Value value) {
+        const auto [row_begin, row_end] = Rows(box);
+        const auto [col_begin, col_end] = Cols(box);
+        for (size_t row = row_begin; row < row_end; ++row) {
+            for (size_t col = col_begin; col < col_end; ++col) {
+                cells_[row * cols_ + col].push_back(value);
+            }
+        }
+    }
+
+    // Записывает отрезок только в ячейки, через которые он проходит
+    // (обход ячеек вдоль прямой, как у Amanatides — Woo)
+    void InsertSegment(Coordinates from, Coordinates to, Value value) {
+        auto add = [&](size_t row, size_t col) {
+            auto& cell = cells_[row * cols_ + col];
+            if (cell.empty() || cell.back() != value) {
+                cell.push_back(value);
+            }
+        };
+        const double x0 = ToCell(from.lng, bounds_.min_lng, cell_lng_);
+        const double y0 = ToCell(from.lat, bounds_.min_lat, cell_lat_);
+        const double x1 = ToCell(to.lng, bounds_.min_lng, cell_lng_);
+        const double y1 = ToCell(to.lat, bounds_.min_lat, cell_lat_);
+        size_t col = Clamp(x0, cols_);
+        size_t row = Clamp(y0, rows_);
+        const size_t end_col = Clamp(x1, cols_);
+        const size_t end_row = Clamp(y1, rows_);
+        const double dx = x1 - x0;
+        const double dy = y1 - y0;
+        const double inf = std::numeric_limits<double>::infinity();
+        // Доля отрезка до следующей границы ячейки по x и по y и шаг между границами
+        double next_x = dx > 0 ? (col + 1 - x0) / dx : dx < 0 ? (col - x0) / dx : inf;
+        double next_y = dy > 0 ? (row + 1 - y0) / dy : dy < 0 ? (row - y0) / dy : inf;
+        const double step_x = dx != 0 ? 1 / std::abs(dx) : inf;
+        const double step_y = dy != 0 ? 1 / std::abs(dy) : inf;
+        for (size_t steps = rows_ + cols_; steps > 0; --steps) {
+            add(row, col);
+            if (row == end_row && col == end_col) {
+                return;
+            }
+            if (next_x < next_y) {
+                if ((dx > 0 && col + 1 >= cols_) || (dx < 0 && col == 0)) {
+                    break;
+                }
+                col = dx > 0 ? col + 1 : col - 1;
+                next_x += step_x;
+            } else {
+                if ((dy > 0 && row + 1 >= rows_) || (dy < 0 && row == 0)) {
+                    break;
+                }
+                row = dy > 0 ? row + 1 : row - 1;
+                next_y += step_y;
+            }
+        }
+        add(end_row, end_col);
+    }
+
+    // Элементы из ячеек, задетых box, по возрастанию и без повторов.
+    // Рамка элемента может и не пересекать box: точную проверку делает вызывающий
+    std::vector<Value> Query(const BoundingBox& box) const {
+        std::vector<Value> result;
+        if (cells_.empty() || !box.Intersects(bounds_)) {
+            return result;
+        }
+        const auto [row_begin, row_end] = Rows(box);
+        const auto [col_begin, col_end] = Cols(box);
+        for (size_t row = row_begin; row < row_end; ++row) {
+            for (size_t col = col_begin; col < col_end; ++col) {
+                const auto& cell = cells_[row * cols_ + col];
+                result.insert(result.end(), cell.begin(), cell.end());
+            }
+        }
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+        return result;
+    }
+
+private:
+    static constexpr size_t MAX_SIDE = 1024;
+    // Координата в долях ячейки от края bounds
+    static double ToCell(double value, double origin, double cell) {
+        return cell > 0 ? (value - origin) / cell : 0;
+    }
+    // Номер ячейки; точки за пределами bounds попадают в крайние ячейки
+    static size_t Clamp(double position, size_t count) {
+        return static_cast<size_t>(std::clamp(std::floor(position), 0.0, static_cast<double>(count - 1)));
+    }
+    // Полуинтервал номеров ячеек, задетых отрезком [min, max]
+    static std::pair<size_t, size_t> Span(double min, double max, double origin, double cell, size_t count) {
+        return {Clamp(ToCell(min, origin, cell), count), Clamp(ToCell(max, origin, cell), count) + 1};
+    }
+    std::pair<size_t, size_t> Rows(const BoundingBox& box) const {
+        return Span(box.min_lat, box.max_lat, bounds_.min_lat, cell_lat_, rows_);
+    }
+    std::pair<size_t, size_t> Cols(const BoundingBox& box) const {
+        return Span(box.min_lng, box.max_lng, bounds_.min_lng, cell_lng_, cols_);
+    }
+
+    BoundingBox bounds_;
+    size_t rows_ = 0;
+    size_t cols_ = 0;
+    double cell_lat_ = 0;
+    double cell_lng_ = 0;
+    std::vector<std::vector<Value>> cells_;
+};
+
+}  // namespace spatial
@@ -1,13 +1,330 @@
 #include "svg.h"
+#include "escape.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
 
 namespace svg {
 
 using namespace std::literals;
 
+namespace {
+
+// С размером холста изображение обрезается по нему: в заголовке
+// появляются width, height и viewBox
+void RenderHeader(OutputBuffer& out, const std::optional<Point>& size) {
+    out << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>"sv;
+    out.EndLine();
+    out << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\""sv;
+    if (size) {
+        out << " width=\""sv << size->x << "\" height=\""sv << size->y
+            << "\" viewBox=\"0 0 "sv << size->x << ' ' << size->y << '"';
+    }
+    out << '>';
+    out.EndLine();
+}
+
+// Буфера хватает на любое число в любом из форматов, кроме FIXED
+// с очень большими значениями: для них берётся GENERAL
+using NumberChars = std::array<char, 64>;
+
+std::string_view FormatNumber(NumberChars& chars, double value, NumberFormat format) {
+    char* const first = chars.data();
+    char* const last = first + chars.size();
+    if (format.style == NumberStyle::FIXED) {
+        const auto result = std::to_chars(first, last, value, std::chars_format::fixed, format.precision);
+        if (result.ec == std::errc{}) {
+            std::string_view text(first, result.ptr - first);
+            if (text.find('.') != text.npos) {
+                text.remove_suffix(text.size() - 1 - text.find_last_not_of('0'));
+                if (text.back() == '.') {
+                    text.remove_suffix(1);
+                }
+            }
+            return text;
+        }
+    }
+    if (format.style != NumberStyle::SHORTEST) {
+        const auto result = std::to_chars(first, last, value, std::chars_format::general, format.precision);
+        if (result.ec == std::errc{}) {
+            return {first, static_cast<size_t>(result.ptr - first)};
+        }
+    }
+    // Точность не уместилась в буфер: кратчайшая запись помещается всегда
+    const auto result = std::to_chars(first, last, value);
+    return {first, static_cast<size_t>(result.ptr - first)};
+}
+
+template <typename Int>
+std::string_view FormatInteger(NumberChars& chars, Int value) {
+    const auto result = std::to_chars(chars.data(), chars.data() + chars.size(), value);
+    return {chars.data(), static_cast<size_t>(result.ptr - chars.data())};
+}
+
+}  // namespace
+
+OutputBuffer::OutputBuffer(std::ostream& output, NumberFormat format, size_t flush_threshold)
+    : output_(&output)
+    , format_(format)
+    , flush_threshold_(flush_threshold)
+    , buffer_(own_buffer_) {
+    buffer_.reserve(flush_threshold_ + flush_threshold_ / 4);
+}
+
+OutputBuffer::OutputBuffer(std::string& output, NumberFormat format)
+    : format_(format)
+    , buffer_(output) {
+}
+
+OutputBuffer::~OutputBuffer() {
+    Flush();
+}
+
+OutputBuffer& OutputBuffer::operator<<(int value) {
+    NumberChars chars;
+    buffer_ += FormatInteger(chars, value);
+    return *this;
+}
+
+OutputBuffer& OutputBuffer::operator<<(uint32_t value) {
+    NumberChars chars;
+    buffer_ += FormatInteger(chars, value);
+    return *this;
+}
+
+OutputBuffer& OutputBuffer::operator<<(double value) {
+    NumberChars chars;
+    buffer_ += FormatNumber(chars, value, format_);
+    return *this;
+}
+
+void OutputBuffer::Flush() {
+    if (output_) {
+        output_->write(buffer_.data(), buffer_.size());
+        buffer_.clear();
+    }
+}
+
 void Object::Render(const RenderContext& context) const {
     context.RenderIndent();
     RenderObject(context);
-    context.out << std::endl;
+    context.out.EndLine();
+}
+
+void RenderStyle(const PathStyle& style, OutputBuffer& out) {
+    if (style.fill_color) {
+        out << " fill=\""sv << *style.fill_color << "\""sv;
+    }
+    if (style.stroke_color) {
+        out << " stroke=\""sv << *style.stroke_color << "\""sv;
+    }
+    if (style.stroke_width) {
+        out << " stroke-width=\""sv << *style.stroke_width << "\""sv;
+    }
+    if (style.stroke_linecap) {
+        out << " stroke-linecap=\""sv << *style.stroke_linecap << "\""sv;
+    }
+    if (style.stroke_linejoin) {
+        out << " stroke-linejoin=\""sv << *style.stroke_linejoin << "\""sv;
+    }
+}
+
+namespace {
+
+void RenderFont(const FontStyle& font, OutputBuffer& out) {
+    out << " font-size=\""sv << font.font_size << "\""sv;
+    if (!font.font_family.empty()) {
+        out << " font-family=\""sv << font.font_family << "\""sv;
+    }
+    if (!font.font_weight.empty()) {
+        out << " font-weight=\""sv << font.font_weight << "\""sv;
+    }
+}
+
+// Выводит ссылку на класс вместо атрибутов оформления;
+// false — если таблицы классов нет и атрибуты нужно вывести
+bool RenderClass(const RenderContext& context, const PathStyle& style, const FontStyle* font) {
+    if (!context.styles) {
+        return false;
+    }
+    if (const auto id = context.styles->GetClass(style, font)) {
+        context.out << " class=\"c"sv << static_cast<uint32_t>(*id) << "\""sv;
+    }
+    return true;
+}
+
+// Вывод примитивов общий для объектов и для CompactDocument
+
+void RenderCircle(const RenderContext& context, Point center, double radius, const PathStyle& style) {
+    auto& out = context.out;
+    out << "<circle cx=\""sv << center.x << "\" cy=\""sv << center.y << "\" "sv;
+    out << "r=\""sv << radius << "\""sv;
+    if (!RenderClass(context, style, nullptr)) {
+        RenderStyle(style, out);
+    }
+    out << "/>"sv;
+}
+
+void RenderPolyline(const RenderContext& context, const Point* begin, const Point* end, const PathStyle& style) {
+    auto& out = context.out;
+    out << "<polyline points=\""sv;
+    bool first = true;
+    for (const Point* point = begin; point != end; ++point) {
+        if (!first) {
+            out << " "sv;
+        }
+        out << point->x << ","sv << point->y;
+        first = false;
+    }
+    out << "\""sv;
+    if (!RenderClass(context, style, nullptr)) {
+        RenderStyle(style, out);
+    }
+    out << "/>"sv;
+}
+
+struct TextView {
+    Point position;
+    Point offset;
+    FontStyle font;
+    std::string_view data;
+};
+
+void RenderText(const RenderContext& context, const TextView& text, const PathStyle& style) {
+    auto& out = context.out;
+    out << "<text";
+    const bool classed = RenderClass(context, style, &text.font);
+    if (!classed) {
+        RenderStyle(style, out);
+    }
+    out << " x=\"" << text.position.x << "\" y=\""sv << text.position.y << "\""sv;
+    out << " dx=\""sv << text.offset.x << "\" dy=\""sv << text.offset.y << "\""sv;
+    if (!classed) {
+        RenderFont(text.font, out);
+    }
+    out << ">" << text.data << "<";
+    out << "/text>"sv;
+}
+
+// Выводит объекты документа, которые render_objects пишет в контекст.
+// В режиме CLASSES объекты сначала пишутся в отдельную строку: блок
+// <style> со всеми найденными классами должен идти перед ними
+template <typename RenderObjects>
+void RenderWithStyles(OutputBuffer& out, StyleMode style_mode, RenderObjects render_objects) {
+    if (style_mode == StyleMode::INLINE) {
+        render_objects(RenderContext(out, 2));
+        return;
+    }
+    StyleSheet styles(out.GetNumberFormat());
+    std::string body;
+    {
+        OutputBuffer body_out(body, out.GetNumberFormat());
+        render_objects(RenderContext(body_out, 2, 0, &styles));
+    }
+    styles.Render(RenderContext(out, 2));
+    out << body;
+}
+
+}  // namespace
+
+StyleSheet::StyleSheet(NumberFormat format)
+    : format_(format) {
+}
+
+bool StyleSheet::Matches(const Entry& entry, const PathStyle& style, const FontStyle* font) {
+    if (entry.style != style || entry.font_size.has_value() != (font != nullptr)) {
+        return false;
+    }
+    return !font || (*entry.font_size == font->font_size && entry.font_family == font->font_family
+                     && entry.font_weight == font->font_weight);
+}
+
+std::optional<size_t> StyleSheet::GetClass(const PathStyle& style, const FontStyle* font) {
+    for (const size_t id : recent_) {
+        if (id < entries_.size() && Matches(entries_[id], style, font)) {
+            return id;
+        }
+    }
+    key_.clear();
+    {
+        OutputBuffer key_out(key_, format_);
+        RenderStyle(style, key_out);
+        if (font) {
+            RenderFont(*font, key_out);
+        }
+    }
+    if (key_.empty()) {
+        return std::nullopt;
+    }
+    if (const auto it = index_.find(key_); it != index_.end()) {
+        recent_[1] = recent_[0];
+        recent_[0] = it->second;
+        return it->second;
+    }
+    Entry entry{style, std::nullopt, {}, {}};
+    if (font) {
+        entry.font_size = font->font_size;
+        entry.font_family = font->font_family;
+        entry.font_weight = font->font_weight;
+    }
+    entries_.push_back(std::move(entry));
+    index_.emplace(key_, entries_.size() - 1);
+    recent_[1] = recent_[0];
+    recent_[0] = entries_.size() - 1;
+    return entries_.size() - 1;
+}
+
+void StyleSheet::Render(const RenderContext& context) const {
+    auto& out = context.out;
+    context.RenderIndent();
+    out << "<style>"sv;
+    out.EndLine();
+    const RenderContext inner = context.Indented();
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        const Entry& entry = entries_[i];
+        inner.RenderIndent();
+        out << ".c"sv << static_cast<uint32_t>(i) << "{"sv;
+        // Длины в CSS указываются с единицами: px равен единице пользовательских координат
+        bool first = true;
+        auto declare = [&](std::string_view name) -> OutputBuffer& {
+            if (!first) {
+                out << ';';
+            }
+            first = false;
+            return out << name << ':';
+        };
+        const PathStyle& style = entry.style;
+        if (style.fill_color) {
+            declare("fill"sv) << *style.fill_color;
+        }
+        if (style.stroke_color) {
+            declare("stroke"sv) << *style.stroke_color;
+        }
+        if (style.stroke_width) {
+            declare("stroke-width"sv) << *style.stroke_width << "px"sv;
+        }
+        if (style.stroke_linecap) {
+            declare("stroke-linecap"sv) << *style.stroke_linecap;
+        }
+        if (style.stroke_linejoin) {
+            declare("stroke-linejoin"sv) << *style.stroke_linejoin;
+        }
+        if (entry.font_size) {
+            declare("font-size"sv) << *entry.font_size << "px"sv;
+        }
+        if (!entry.font_family.empty()) {
+            declare("font-family"sv) << entry.font_family;
+        }
+        if (!entry.font_weight.empty()) {
+            declare("font-weight"sv) << entry.font_weight;
+        }
+        out << "}"sv;
+        out.EndLine();
+    }
+    context.RenderIndent();
+    out << "</style>"sv;
+    out.EndLine();
 }
 
 Circle& Circle::SetCenter(Point center) {
@@ -21,11 +338,7 @@ Circle& Circle::SetRadius(double radius) {
 }
 
 void Circle::RenderObject(const RenderContext& context) const {
-    auto& out = context.out;
-    out << "<circle cx=\""sv << center_.x << "\" cy=\""sv << center_.y << "\" "sv;
-    out << "r=\""sv << radius_ << "\""sv;
-    RenderAttrs(context.out);
-    out << "/>"sv;
+    RenderCircle(context, center_, radius_, GetStyle());
 }
 
 Polyline& Polyline::AddPoint(Point point) {
@@ -33,20 +346,13 @@ Polyline& Polyline::AddPoint(Point point) {
     return *this;
 }
 
+Polyline& Polyline::ClearPoints() {
+    points_.clear();
+    return *this;
+}
+
 void Polyline::RenderObject(const RenderContext& context) const {
-    auto& out = context.out;
-    out << "<polyline points=\""sv;
-    bool first = true;
-    for (const auto& point : points_) {
-        if (!first) {
-            out << " "sv;
-        }
-        out << point.x << ","sv << point.y;
-        first = false;
-    }
-    out << "\""sv;
-    RenderAttrs(context.out);
-    out << "/>"sv;
+    RenderPolyline(context, points_.data(), points_.data() + points_.size(), GetStyle());
 }
 
 Text& Text::SetPosition(Point pos) {
@@ -64,63 +370,161 @@ Text& Text::SetFontSize(uint32_t size) {
     return *this;
 }
 
-Text& Text::SetFontFamily(std::string font_family) {
-    font_family_ = std::move(font_family);
+Text& Text::SetFontFamily(std::string_view font_family) {
+    font_family_.assign(font_family);
     return *this;
 }
 
-Text& Text::SetFontWeight(std::string font_weight) {
-    font_weight_ = std::move(font_weight);
+Text& Text::SetFontWeight(std::string_view font_weight) {
+    font_weight_.assign(font_weight);
     return *this;
 }
 
-Text& Text::SetData(std::string data) {
-    data_ = std::move(data);
+Text& Text::SetData(std::string_view data) {
+    data_.assign(data);
     return *this;
 }
 
 void Text::RenderObject(const RenderContext& context) const {
-    auto& out = context.out;
-    out << "<text";
-    RenderAttrs(context.out);
-    out << " x=\"" << position_.x << "\" y=\""sv << position_.y << "\""sv;
-    out << " dx=\""sv << offset_.x << "\" dy=\""sv << offset_.y << "\""sv;
-    out << " font-size=\""sv << font_size_ << "\""sv;
-    if (!font_family_.empty()) {
-        out << " font-family=\""sv << font_family_ << "\""sv;
-    }
-    if (!font_weight_.empty()) {
-        out << " font-weight=\""sv << font_weight_ << "\""sv;
-    }
-    out << ">" << data_ << "<";
-    out << "/text>"sv;
+    RenderText(context, {position_, offset_, {font_size_, font_family_, font_weight_}, data_}, GetStyle());
 }
 
 std::string Text::EscapeText(const std::string& text) {
-    std::string result;
-    for (char c : text) {
-        switch (c) {
-        case '"': result += "&quot;"; break;
-        case '\'': result += "&apos;"; break;
-        case '<': result += "&lt;"; break;
-        case '>': result += "&gt;"; break;
-        case '&': result += "&amp;"; break;
-        default: result += c; break;
-        }
-    }
-    return result;
+    return escape::Xml().Escaped(text);
 }
 
-void Document::Render(std::ostream& out) const {
-    out << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>"sv << std::endl;
-    out << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">"sv << std::endl;
+void Document::Render(std::ostream& out, NumberFormat format, StyleMode style_mode) const {
+    OutputBuffer buffer(out, format);
+    Render(buffer, style_mode);
+}
 
-    RenderContext ctx(out, 2);
+void Document::Render(std::string& out, NumberFormat format, StyleMode style_mode) const {
+    OutputBuffer buffer(out, format);
+    Render(buffer, style_mode);
+}
+
+void Document::Render(OutputBuffer& out, StyleMode style_mode) const {
+    RenderHeader(out, size_);
+    RenderWithStyles(out, style_mode, [this](const RenderContext& context) {
+        RenderObjects(context);
+    });
+    out << "</svg>"sv;
+}
+
+void Document::RenderObjects(const RenderContext& context) const {
     for (const auto& obj : objects_) {
-        obj->Render(ctx);
+        obj->Render(context);
+    }
+}
+
+StreamDocument::StreamDocument(std::ostream& out, NumberFormat format, std::optional<Point> size)
+    : buffer_(out, format)
+    , context_(buffer_, 2) {
+    RenderHeader(buffer_, size);
+}
+
+StreamDocument::StreamDocument(std::string& out, NumberFormat format, std::optional<Point> size)
+    : buffer_(out, format)
+    , context_(buffer_, 2) {
+    RenderHeader(buffer_, size);
+}
+
+void StreamDocument::AddRendered(std::string_view objects) {
+    buffer_ << objects;
+    buffer_.Flush();
+}
+
+void StreamDocument::Close() {
+    buffer_ << "</svg>"sv;
+    buffer_.Flush();
+}
+
+Fragment::Fragment(std::string& out, NumberFormat format)
+    : buffer_(out, format)
+    , context_(buffer_, 2) {
+}
+
+void CompactDocument::Add(const Circle& circle) {
+    items_.emplace_back(CircleItem{circle.center_, circle.radius_, InternStyle(circle.GetStyle())});
+}
+
+void CompactDocument::Add(const Polyline& polyline) {
+    const auto first_point = static_cast<Index>(points_.size());
+    points_.insert(points_.end(), polyline.points_.begin(), polyline.points_.end());
+    items_.emplace_back(PolylineItem{first_point, static_cast<Index>(polyline.points_.size()),
+                                     InternStyle(polyline.GetStyle())});
+}
+
+void CompactDocument::Add(const Text& text) {
+    const auto data_begin = static_cast<Index>(text_.size());
+    text_ += text.data_;
+    items_.emplace_back(TextItem{text.position_, text.offset_, text.font_size_,
+                                 InternString(text.font_family_), InternString(text.font_weight_),
+                                 data_begin, static_cast<Index>(text.data_.size()),
+                                 InternStyle(text.GetStyle())});
+}
+
+void CompactDocument::Render(std::ostream& out, NumberFormat format, StyleMode style_mode) const {
+    OutputBuffer buffer(out, format);
+    Render(buffer, style_mode);
+}
+
+void CompactDocument::Render(std::string& out, NumberFormat format, StyleMode style_mode) const {
+    OutputBuffer buffer(out, format);
+    Render(buffer, style_mode);
+}
+
+CompactDocument::Index CompactDocument::InternStyle(const PathStyle& style) {
+    // Подряд обычно идут объекты одного стиля
+    if (last_style_ < styles_.size() && styles_[last_style_] == style) {
+        return last_style_;
+    }
+    const auto it = std::find(styles_.begin(), styles_.end(), style);
+    last_style_ = static_cast<Index>(it - styles_.begin());
+    if (it == styles_.end()) {
+        styles_.push_back(style);
+    }
+    return last_style_;
+}
+
+CompactDocument::Index CompactDocument::InternString(std::string_view value) {
+    const auto it = std::find(strings_.begin(), strings_.end(), value);
+    const auto index = static_cast<Index>(it - strings_.begin());
+    if (it == strings_.end()) {
+        strings_.emplace_back(value);
     }
+    return index;
+}
 
+void CompactDocument::Render(OutputBuffer& out, StyleMode style_mode) const {
+    RenderHeader(out, size_);
+    RenderWithStyles(out, style_mode, [this](const RenderContext& context) {
+        RenderObjects(context);
+    });
     out << "</svg>"sv;
 }
 
+void CompactDocument::RenderObjects(const RenderContext& context) const {
+    auto& out = context.out;
+    const std::string_view text = text_;
+    for (const auto& item : items_) {
+        context.RenderIndent();
+        std::visit([&](const auto& value) {
+            using T = std::decay_t<decltype(value)>;
+            const PathStyle& style = styles_[value.style];
+            if constexpr (std::is_same_v<T, CircleItem>) {
+                RenderCircle(context, value.center, value.radius, style);
+            } else if constexpr (std::is_same_v<T, PolylineItem>) {
+                const Point* begin = points_.data() + value.first_point;
+                RenderPolyline(context, begin, begin + value.point_count, style);
+            } else {
+                RenderText(context, {value.position, value.offset,
+                                     {value.font_size, strings_[value.font_family], strings_[value.font_weight]},
+                                     text.substr(value.data_begin, value.data_size)}, style);
+            }
+        }, item);
+        out.EndLine();
+    }
+}
+
 }  // namespace svg
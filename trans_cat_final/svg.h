@@ -4,8 +4,11 @@
 #include <iostream>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 #include <utility>
+#include <variant>
 #include <optional>
 #include <iostream>
 
@@ -21,30 +24,95 @@ struct Point {
     double y = 0;
 };
 
+// Запись дробных чисел: координат, радиусов, толщины линий
+enum class NumberStyle {
+    GENERAL,   // precision значащих цифр, как std::ostream (по умолчанию 6)
+    FIXED,     // precision цифр после точки, без нулей в конце
+    SHORTEST,  // кратчайшая запись, которая читается обратно в то же число
+};
+
+struct NumberFormat {
+    NumberStyle style = NumberStyle::GENERAL;
+    int precision = 6;
+};
+
+// У double не больше 17 значащих цифр: бо́льшая точность ничего не добавляет
+inline constexpr int MAX_PRECISION = 17;
+
+// Буфер вывода SVG. Объекты дописываются в строку, числа форматируются
+// через std::to_chars, в поток текст уходит блоками по flush_threshold байт
+class OutputBuffer {
+public:
+    explicit OutputBuffer(std::ostream& output, NumberFormat format = {},
+                          size_t flush_threshold = 1 << 16);
+    // Дописывает в конец output, в поток ничего не сбрасывается
+    explicit OutputBuffer(std::string& output, NumberFormat format = {});
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+    ~OutputBuffer();
+
+    OutputBuffer& operator<<(std::string_view text) {
+        buffer_ += text;
+        return *this;
+    }
+    OutputBuffer& operator<<(char c) {
+        buffer_.push_back(c);
+        return *this;
+    }
+    OutputBuffer& operator<<(int value);
+    OutputBuffer& operator<<(uint32_t value);
+    OutputBuffer& operator<<(double value);
+
+    // Завершает строку объекта; при заполнении буфер сбрасывается в поток
+    void EndLine() {
+        buffer_.push_back('\n');
+        if (output_ && buffer_.size() >= flush_threshold_) {
+            Flush();
+        }
+    }
+    void Flush();
+
+    NumberFormat GetNumberFormat() const {
+        return format_;
+    }
+
+private:
+    std::ostream* output_ = nullptr;
+    NumberFormat format_;
+    size_t flush_threshold_ = 0;
+    std::string own_buffer_;
+    std::string& buffer_;
+};
+
+class StyleSheet;
+
 struct RenderContext {
-    RenderContext(std::ostream& out)
+    RenderContext(OutputBuffer& out)
         : out(out) {
     }
 
-    RenderContext(std::ostream& out, int indent_step, int indent = 0)
+    RenderContext(OutputBuffer& out, int indent_step, int indent = 0, StyleSheet* styles = nullptr)
         : out(out)
         , indent_step(indent_step)
-        , indent(indent) {
+        , indent(indent)
+        , styles(styles) {
     }
 
     RenderContext Indented() const {
-        return {out, indent_step, indent + indent_step};
+        return {out, indent_step, indent + indent_step, styles};
     }
 
     void RenderIndent() const {
         for (int i = 0; i < indent; ++i) {
-            out.put(' ');
+            out << ' ';
         }
     }
 
-    std::ostream& out;
+    OutputBuffer& out;
     int indent_step = 0;
     int indent = 0;
+    // Если задана, оформление выводится не атрибутами, а ссылкой на класс
+    StyleSheet* styles = nullptr;
 };
 class Object {
 public:
@@ -68,77 +136,139 @@ enum class StrokeLineJoin {
     MITER_CLIP,
     ROUND,
 };
+inline std::string_view ToString(StrokeLineCap line_cap) {
+    using namespace std::literals;
+    if (line_cap == StrokeLineCap::BUTT) {
+        return "butt"sv;
+    } else if (line_cap == StrokeLineCap::ROUND) {
+        return "round"sv;
+    }
+    return "square"sv;
+}
+inline std::string_view ToString(StrokeLineJoin line_join) {
+    using namespace std::literals;
+    if (line_join == StrokeLineJoin::ARCS) {
+        return "arcs"sv;
+    } else if (line_join == StrokeLineJoin::BEVEL) {
+        return "bevel"sv;
+    } else if (line_join == StrokeLineJoin::MITER) {
+        return "miter"sv;
+    } else if (line_join == StrokeLineJoin::MITER_CLIP) {
+        return "miter-clip"sv;
+    }
+    return "round"sv;
+}
 inline std::ostream& operator<<(std::ostream& os, const StrokeLineCap& line_cap)
 {
-    if(line_cap == StrokeLineCap::BUTT){
-        os << "butt";
-    }else if(line_cap == StrokeLineCap::ROUND){
-        os << "round";
-    }else{
-        os << "square";
-    }
-    return os;
+    return os << ToString(line_cap);
 }
-inline std::ostream& operator<<(std::ostream& os, const StrokeLineJoin& line_cap)
+inline std::ostream& operator<<(std::ostream& os, const StrokeLineJoin& line_join)
 {
-    if(line_cap == StrokeLineJoin::ARCS){
-        os << "arcs";
-    }else if(line_cap == StrokeLineJoin::BEVEL){
-        os << "bevel";
-    }else if(line_cap == StrokeLineJoin::MITER){
-        os << "miter";
-    }else if(line_cap == StrokeLineJoin::MITER_CLIP){
-        os << "miter-clip";
-    }else{
-        os << "round";
-    }
-    return os;
+    return os << ToString(line_join);
+}
+inline OutputBuffer& operator<<(OutputBuffer& out, StrokeLineCap line_cap) {
+    return out << ToString(line_cap);
+}
+inline OutputBuffer& operator<<(OutputBuffer& out, StrokeLineJoin line_join) {
+    return out << ToString(line_join);
 }
 using Color = std::string;
 inline const Color NoneColor{"none"};
+// Общие для всех путей атрибуты fill и stroke
+struct PathStyle {
+    std::optional<Color> fill_color;
+    std::optional<Color> stroke_color;
+    std::optional<double> stroke_width;
+    std::optional<StrokeLineCap> stroke_linecap;
+    std::optional<StrokeLineJoin> stroke_linejoin;
+
+    bool operator==(const PathStyle& other) const {
+        return fill_color == other.fill_color && stroke_color == other.stroke_color
+            && stroke_width == other.stroke_width && stroke_linecap == other.stroke_linecap
+            && stroke_linejoin == other.stroke_linejoin;
+    }
+    bool operator!=(const PathStyle& other) const {
+        return !(*this == other);
+    }
+};
+// Выводит заданные атрибуты стиля, каждый с пробелом впереди
+void RenderStyle(const PathStyle& style, OutputBuffer& out);
+
+// Атрибуты шрифта надписи
+struct FontStyle {
+    uint32_t font_size = 1;
+    std::string_view font_family;
+    std::string_view font_weight;
+};
+
+// Как выводится оформление элементов
+enum class StyleMode {
+    INLINE,   // атрибутами каждого элемента
+    CLASSES,  // один раз в блоке <style>, элементы ссылаются на класс
+};
+
+// Таблица CSS-классов: одинаковые наборы атрибутов оформления получают
+// один класс в порядке первого появления
+class StyleSheet {
+public:
+    explicit StyleSheet(NumberFormat format = {});
+
+    // Номер класса для набора; у элементов без оформления — nullopt
+    std::optional<size_t> GetClass(const PathStyle& style, const FontStyle* font);
+    // Выводит блок <style> с отступом context
+    void Render(const RenderContext& context) const;
+
+private:
+    struct Entry {
+        PathStyle style;
+        std::optional<uint32_t> font_size;
+        std::string font_family;
+        std::string font_weight;
+    };
+
+    static bool Matches(const Entry& entry, const PathStyle& style, const FontStyle* font);
+
+    NumberFormat format_;
+    // Ключ — атрибуты в том виде, в каком они выводились бы в элементе
+    std::unordered_map<std::string, size_t> index_;
+    std::vector<Entry> entries_;
+    std::string key_;
+    // Два последних найденных класса: соседние элементы обычно чередуют
+    // пару наборов (подложка и надпись), их проверка дешевле поиска по ключу
+    size_t recent_[2] = {0, 0};
+};
+
 template <typename Owner>
 class PathProps {
 public:
     Owner& SetFillColor(Color color) {
-        fill_color_ = std::move(color);
+        style_.fill_color = std::move(color);
         return AsOwner();
     }
     Owner& SetStrokeColor(Color color) {
-        stroke_color_ = std::move(color);
+        style_.stroke_color = std::move(color);
         return AsOwner();
     }
     Owner& SetStrokeWidth(double width){
-        stroke_width_ = std::move(width);
+        style_.stroke_width = std::move(width);
         return AsOwner();
     }
     Owner& SetStrokeLineCap(StrokeLineCap line_cap){
-        stroke_linecap_ = std::move(line_cap);
+        style_.stroke_linecap = std::move(line_cap);
         return AsOwner();
     }
     Owner& SetStrokeLineJoin(StrokeLineJoin line_join){
-        stroke_linejoin_ = std::move(line_join);
+        style_.stroke_linejoin = std::move(line_join);
         return AsOwner();
     }
+    const PathStyle& GetStyle() const {
+        return style_;
+    }
 protected:
     ~PathProps() = default;
     // Метод RenderAttrs выводит в поток общие для всех путей атрибуты fill и stroke
-    void RenderAttrs(std::ostream& out) const {
-        using namespace std::literals;
-        if (fill_color_) {
-            out << " fill=\""sv << *fill_color_ << "\""sv;
-        }
-        if (stroke_color_) {
-            out << " stroke=\""sv << *stroke_color_ << "\""sv;
-        }
-        if (stroke_width_) {
-            out << " stroke-width=\""sv << *stroke_width_ << "\""sv;
-        }
-        if (stroke_linecap_) {
-            out << " stroke-linecap=\""sv << *stroke_linecap_ << "\""sv;
-        }
-        if (stroke_linejoin_) {
-            out << " stroke-linejoin=\""sv << *stroke_linejoin_ << "\""sv;
-        }
+    void RenderAttrs(OutputBuffer& out) const {
+        RenderStyle(style_, out);
     }
 private:
     Owner& AsOwner() {
@@ -147,12 +277,7 @@ private:
         return static_cast<Owner&>(*this);
     }
 
-    std::optional<Color> fill_color_ = std::nullopt;
-    std::optional<Color> stroke_color_ = std::nullopt;
-    std::optional<double> stroke_width_ = std::nullopt;
-    std::optional<StrokeLineCap> stroke_linecap_ = std::nullopt;
-    std::optional<StrokeLineJoin> stroke_linejoin_ = std::nullopt;
-
+    PathStyle style_;
 };
 class Circle final : public Object, public PathProps<Circle> {
 public:
@@ -160,6 +285,7 @@ public:
     Circle& SetRadius(double radius);
 
 private:
+    friend class CompactDocument;
     void RenderObject(const RenderContext& context) const override;
     Point center_;
     double radius_ = 1.0;
@@ -168,8 +294,11 @@ private:
 class Polyline final : public Object, public PathProps<Polyline> {
 public:
     Polyline& AddPoint(Point point);
+    // Убирает все точки; память под них остаётся для следующей ломаной
+    Polyline& ClearPoints();
 
 private:
+    friend class CompactDocument;
     void RenderObject(const RenderContext& context) const override;
 
     std::vector<Point> points_;
@@ -180,11 +309,13 @@ public:
     Text& SetPosition(Point pos);
     Text& SetOffset(Point offset);
     Text& SetFontSize(uint32_t size);
-    Text& SetFontFamily(std::string font_family);
-    Text& SetFontWeight(std::string font_weight);
-    Text& SetData(std::string data);
+    // Строки копируются в уже выделенную память объекта
+    Text& SetFontFamily(std::string_view font_family);
+    Text& SetFontWeight(std::string_view font_weight);
+    Text& SetData(std::string_view data);
 
 private:
+    friend class CompactDocument;
     void RenderObject(const RenderContext& context) const override;
     static std::string EscapeText(const std::string& text);
 
@@ -216,10 +347,130 @@ public:
         objects_.push_back(std::move(obj));
     }
 
-    void Render(std::ostream& out) const;
+    // Размер холста: изображение обрезается по прямоугольнику (0, 0) — size
+    void SetSize(Point size) {
+        size_ = size;
+    }
+
+    void Render(std::ostream& out, NumberFormat format = {}, StyleMode style_mode = StyleMode::INLINE) const;
+    // Дописывает документ в конец out
+    void Render(std::string& out, NumberFormat format = {}, StyleMode style_mode = StyleMode::INLINE) const;
 
 private:
+    void Render(OutputBuffer& out, StyleMode style_mode) const;
+    void RenderObjects(const RenderContext& context) const;
+
     std::vector<std::unique_ptr<Object>> objects_;
+    std::optional<Point> size_;
+};
+
+// Документ, который не хранит объекты: каждый добавленный объект сразу
+// выводится в буфер. Заголовок пишется в конструкторе, закрывающий
+// тег — в Close. Вывод совпадает с Document::Render
+class StreamDocument: public ObjectContainer {
+public:
+    // size — размер холста, как в Document::SetSize
+    explicit StreamDocument(std::ostream& out, NumberFormat format = {}, std::optional<Point> size = std::nullopt);
+    explicit StreamDocument(std::string& out, NumberFormat format = {}, std::optional<Point> size = std::nullopt);
+
+    // Скрывает ObjectContainer::Add: объект выводится без копии в куче
+    template <typename Obj>
+    void Add(const Obj& obj) {
+        obj.Render(context_);
+    }
+    void AddPtr(std::unique_ptr<Object>&& obj) override {
+        obj->Render(context_);
+    }
+    // Дописывает объекты, уже выведенные в svg::Fragment
+    void AddRendered(std::string_view objects);
+
+    void Close();
+
+private:
+    OutputBuffer buffer_;
+    RenderContext context_;
+};
+
+// Часть тела документа без заголовка и закрывающего тега: объекты
+// выводятся в строку сразу, с тем же отступом, что и в документе.
+// Фрагменты, выведенные в разных потоках, склеиваются через
+// StreamDocument::AddRendered
+class Fragment {
+public:
+    explicit Fragment(std::string& out, NumberFormat format = {});
+
+    template <typename Obj>
+    void Add(const Obj& obj) {
+        obj.Render(context_);
+    }
+
+private:
+    OutputBuffer buffer_;
+    RenderContext context_;
+};
+
+// Документ без объектов в куче: примитивы хранятся по значению в одном
+// векторе, точки ломаных и тексты надписей — в общих массивах, а стили
+// и шрифты — в небольших таблицах, на которые примитивы ссылаются по
+// индексу. Вывод совпадает с Document::Render
+class CompactDocument {
+public:
+    void Add(const Circle& circle);
+    void Add(const Polyline& polyline);
+    void Add(const Text& text);
+    // Размер холста, как в Document::SetSize
+    void SetSize(Point size) {
+        size_ = size;
+    }
+
+    void Render(std::ostream& out, NumberFormat format = {}, StyleMode style_mode = StyleMode::INLINE) const;
+    // Дописывает документ в конец out
+    void Render(std::string& out, NumberFormat format = {}, StyleMode style_mode = StyleMode::INLINE) const;
+
+    size_t GetObjectCount() const {
+        return items_.size();
+    }
+    size_t GetStyleCount() const {
+        return styles_.size();
+    }
+
+private:
+    using Index = uint32_t;
+    struct CircleItem {
+        Point center;
+        double radius;
+        Index style;
+    };
+    struct PolylineItem {
+        Index first_point;
+        Index point_count;
+        Index style;
+    };
+    struct TextItem {
+        Point position;
+        Point offset;
+        uint32_t font_size;
+        Index font_family;
+        Index font_weight;
+        Index data_begin;
+        Index data_size;
+        Index style;
+    };
+    using Item = std::variant<CircleItem, PolylineItem, TextItem>;
+
+    // Разных стилей и шрифтов на карте единицы, поэтому поиск линейный
+    Index InternStyle(const PathStyle& style);
+    Index InternString(std::string_view value);
+    void Render(OutputBuffer& out, StyleMode style_mode) const;
+    void RenderObjects(const RenderContext& context) const;
+
+    std::vector<Item> items_;
+    std::vector<Point> points_;
+    std::string text_;
+    std::vector<PathStyle> styles_;
+    std::vector<std::string> strings_;
+    Index last_style_ = 0;
+    std::optional<Point> size_;
 };
 
 }  // namespace svg
@@ -0,0 +1,165 @@
+#include "svgz.h"
+
+#include <stdexcept>
+#include <streambuf>
+#include <vector>
+#include <zlib.h>
+
+namespace svgz {
+
+using namespace std::literals;
+
+namespace {
+
+constexpr std::string_view BASE64_ALPHABET = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"sv;
+
+void EncodeTriple(const unsigned char* bytes, char* out) {
+    out[0] = BASE64_ALPHABET[bytes[0] >> 2];
+    out[1] = BASE64_ALPHABET[((bytes[0] & 0x03) << 4) | (bytes[1] >> 4)];
+    out[2] = BASE64_ALPHABET[((bytes[1] & 0x0F) << 2) | (bytes[2] >> 6)];
+    out[3] = BASE64_ALPHABET[bytes[2] & 0x3F];
+}
+
+}  // namespace
+
+Base64Writer::Base64Writer(std::string& out)
+    : out_(out) {
+}
+
+void Base64Writer::Write(std::string_view data) {
+    auto bytes = reinterpret_cast<const unsigned char*>(data.data());
+    size_t size = data.size();
+    // Дополняем неполную тройку с прошлого раза
+    while (pending_size_ > 0 && pending_size_ < 3 && size > 0) {
+        pending_[pending_size_++] = *bytes++;
+        --size;
+    }
+    if (pending_size_ == 3) {
+        char chars[4];
+        EncodeTriple(pending_.data(), chars);
+        out_.append(chars, 4);
+        pending_size_ = 0;
+    }
+    const size_t triples = size / 3;
+    const size_t begin = out_.size();
+    out_.resize(begin + triples * 4);
+    char* out = out_.data() + begin;
+    for (size_t i = 0; i < triples; ++i, bytes += 3, out += 4) {
+        EncodeTriple(bytes, out);
+    }
+    for (size_t i = triples * 3; i < size; ++i) {
+        pending_[pending_size_++] = *bytes++;
+    }
+}
+
+void Base64Writer::Finish() {
+    if (pending_size_ == 0) {
+        return;
+    }
+    const size_t size = pending_size_;
+    for (size_t i = size; i < 3; ++i) {
+        pending_[i] = 0;
+    }
+    char chars[4];
+    EncodeTriple(pending_.data(), chars);
+    out_.append(chars, size + 1);
+    out_.append(3 - size, '=');
+    pending_size_ = 0;
+}
+
+// Входной буфер потока: накопленное сжимается, когда он заполнится.
+// Большие куски (svg::OutputBuffer сбрасывает по 64 КиБ) уходят в zlib
+// без копирования
+class GzipStream::Buffer : public std::streambuf {
+public:
+    Buffer(int level, Sink sink)
+        : sink_(std::move(sink))
+        , input_(BUFFER_SIZE)
+        , output_(BUFFER_SIZE) {
+        // 15 — окно 32 КиБ, +16 — заголовок и окончание gzip
+        if (deflateInit2(&stream_, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            throw std::invalid_argument("Invalid gzip compression level "s + std::to_string(level));
+        }
+        ResetInput();
+    }
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+    ~Buffer() override {
+        deflateEnd(&stream_);
+    }
+
+    void Finish() {
+        Compress(pbase(), pptr() - pbase(), Z_FINISH);
+        ResetInput();
+    }
+
+protected:
+    int_type overflow(int_type c) override {
+        Compress(pbase(), pptr() - pbase(), Z_NO_FLUSH);
+        ResetInput();
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char* data, std::streamsize size) override {
+        if (static_cast<size_t>(size) < input_.size()) {
+            return std::streambuf::xsputn(data, size);
+        }
+        Compress(pbase(), pptr() - pbase(), Z_NO_FLUSH);
+        ResetInput();
+        Compress(data, static_cast<size_t>(size), Z_NO_FLUSH);
+        return size;
+    }
+
+private:
+    static constexpr size_t BUFFER_SIZE = 1 << 16;
+
+    void ResetInput() {
+        setp(input_.data(), input_.data() + input_.size());
+    }
+
+    void Compress(const char* data, size_t size, int flush) {
+        stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        stream_.avail_in = static_cast<uInt>(size);
+        for (;;) {
+            stream_.next_out = reinterpret_cast<Bytef*>(output_.data());
+            stream_.avail_out = static_cast<uInt>(output_.size());
+            const int result = deflate(&stream_, flush);
+            if (result == Z_STREAM_ERROR) {
+                throw std::runtime_error("deflate failed"s);
+            }
+            if (const size_t produced = output_.size() - stream_.avail_out; produced > 0) {
+                sink_(std::string_view(output_.data(), produced));
+            }
+            // Без Z_FINISH zlib забрал весь вход, если выходной буфер заполнен не до конца
+            if (flush == Z_FINISH ? result == Z_STREAM_END : stream_.avail_out != 0) {
+                break;
+            }
+        }
+    }
+
+    Sink sink_;
+    z_stream stream_{};
+    std::vector<char> input_;
+    std::vector<char> output_;
+};
+
+GzipStream::GzipStream(int level, Sink sink)
+    : std::ostream(nullptr)
+    , buffer_(std::make_unique<Buffer>(level, std::move(sink))) {
+    rdbuf(buffer_.get());
+    // Ошибку zlib не превращаем в молча испорченный поток
+    exceptions(badbit);
+}
+
+GzipStream::~GzipStream() = default;
+
+void GzipStream::Finish() {
+    flush();
+    buffer_->Finish();
+}
+
+}  // namespace svgz
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace svgz {
+
+// Кодирует байты в base64 по мере поступления и дописывает в конец out
+class Base64Writer {
+public:
+    explicit Base64Writer(std::string& out);
+
+    void Write(std::string_view data);
+    // Кодирует оставшиеся один-два байта с дополнением '='
+    void Finish();
+
+private:
+    std::string& out_;
+    std::array<unsigned char, 3> pending_{};
+    size_t pending_size_ = 0;
+};
+
+// Уровни сжатия zlib: 0 — без сжатия, 9 — наилучшее
+inline constexpr int MIN_LEVEL = 0;
+inline constexpr int MAX_LEVEL = 9;
+
+// Поток вывода, который сжимает всё записанное в gzip (формат SVGZ) через
+// zlib и передаёт сжатые байты в sink по мере заполнения выходного буфера.
+// Ни исходные, ни сжатые данные не копятся целиком
+class GzipStream : public std::ostream {
+public:
+    using Sink = std::function<void(std::string_view)>;
+
+    // level — от MIN_LEVEL до MAX_LEVEL, иначе std::invalid_argument
+    GzipStream(int level, Sink sink);
+    ~GzipStream() override;
+
+    // Сжимает остаток и дописывает окончание gzip; после этого писать нельзя
+    void Finish();
+
+private:
+    class Buffer;
+    std::unique_ptr<Buffer> buffer_;
+};
+
+}  // namespace svgz
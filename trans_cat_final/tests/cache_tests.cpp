@@ -0,0 +1,176 @@
+#include "test_framework.h"
+
+#include "../lfu_cache.h"
+#include "../lru_cache.h"
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::literals;
+
+namespace {
+
+using Lfu = cache::LfuCache<std::string, int>;
+using Lru = cache::ShardedLruCache<std::string, int>;
+
+std::shared_ptr<const int> Value(int value) {
+    return std::make_shared<const int>(value);
+}
+
+void TestLfuHitsAndMisses() {
+    Lfu lfu(100);
+    ASSERT(!lfu.Get("a"));
+    ASSERT(lfu.Offer("a", Value(1), 10));
+    ASSERT_EQUAL(*lfu.Get("a"), 1);
+    // Повторное предложение того же ключа ничего не меняет
+    ASSERT(lfu.Offer("a", Value(2), 10));
+    ASSERT_EQUAL(*lfu.Get("a"), 1);
+    const auto stats = lfu.GetStats();
+    ASSERT_EQUAL(stats.hits, 2u);
+    ASSERT_EQUAL(stats.misses, 1u);
+    ASSERT_EQUAL(stats.entries, 1u);
+    ASSERT_EQUAL(stats.bytes, 10u);
+}
+
+// Значение вытесняет только более редкие; более редкое само не принимается
+void TestLfuEvictsRarest() {
+    Lfu lfu(20);
+    for (int i = 0; i < 3; ++i) {
+        lfu.Get("often");
+    }
+    lfu.Get("rare");
+    ASSERT(lfu.Offer("often", Value(1), 10));
+    ASSERT(lfu.Offer("rare", Value(2), 10));
+    lfu.Get("new");
+    ASSERT(!lfu.Offer("new", Value(3), 10));
+    ASSERT_EQUAL(lfu.GetStats().rejections, 1u);
+    lfu.Get("new");
+    lfu.Get("new");
+    ASSERT(lfu.Offer("new", Value(3), 10));
+    ASSERT(lfu.Get("often"));
+    ASSERT(!lfu.Get("rare"));
+    const auto stats = lfu.GetStats();
+    ASSERT_EQUAL(stats.evictions, 1u);
+    ASSERT_EQUAL(stats.entries, 2u);
+    ASSERT_EQUAL(stats.bytes, 20u);
+}
+
+void TestLfuRejectsOversized() {
+    Lfu lfu(10);
+    lfu.Get("big");
+    ASSERT(!lfu.Offer("big", Value(1), 11));
+    ASSERT(lfu.Offer("fit", Value(2), 10));
+    const auto stats = lfu.GetStats();
+    ASSERT_EQUAL(stats.rejections, 1u);
+    ASSERT_EQUAL(stats.entries, 1u);
+}
+
+// После старения прежде популярный ключ уступает новому
+void TestLfuAging() {
+    Lfu lfu(10, 8);
+    for (int i = 0; i < 7; ++i) {
+        lfu.Get("old");
+    }
+    ASSERT(lfu.Offer("old", Value(1), 10));
+    // Восьмое обращение делит счётчики пополам: у old остаётся 3
+    lfu.Get("new");
+    for (int i = 0; i < 8; ++i) {
+        lfu.Get("new");
+    }
+    // Снова старение: old — 1, new — 4
+    ASSERT(lfu.Offer("new", Value(2), 10));
+    ASSERT(!lfu.Get("old"));
+    ASSERT_EQUAL(*lfu.Get("new"), 2);
+}
+
+// С одним шардом весь бюджет общий, и порядок вытеснения предсказуем
+void TestLruEvictsLeastRecent() {
+    Lru lru(30, 1);
+    lru.Put("a", Value(1), 10);
+    lru.Put("b", Value(2), 10);
+    lru.Put("c", Value(3), 10);
+    ASSERT(lru.Get("a"));
+    lru.Put("d", Value(4), 10);
+    ASSERT(!lru.Get("b"));
+    ASSERT(lru.Get("a"));
+    ASSERT(lru.Get("c"));
+    ASSERT(lru.Get("d"));
+    const auto stats = lru.GetStats();
+    ASSERT_EQUAL(stats.hits, 4u);
+    ASSERT_EQUAL(stats.misses, 1u);
+    ASSERT_EQUAL(stats.evictions, 1u);
+    ASSERT_EQUAL(stats.entries, 3u);
+    ASSERT_EQUAL(stats.bytes, 30u);
+}
+
+// Замена значения учитывает новый размер; значение больше бюджета не принимается
+void TestLruReplaceAndReject() {
+    Lru lru(30, 1);
+    lru.Put("a", Value(1), 10);
+    lru.Put("a", Value(2), 25);
+    ASSERT_EQUAL(*lru.Get("a"), 2);
+    ASSERT_EQUAL(lru.GetStats().bytes, 25u);
+    lru.Put("b", Value(3), 31);
+    ASSERT(!lru.Get("b"));
+    const auto stats = lru.GetStats();
+    ASSERT_EQUAL(stats.rejections, 1u);
+    ASSERT_EQUAL(stats.entries, 1u);
+}
+
+// Clear удаляет значения, но не счётчики обращений. Значение, посчитанное
+// до Clear, с прежним поколением в кеш не попадает
+void TestLruClearAndGeneration() {
+    Lru lru(100, 4);
+    const uint64_t generation = lru.GetGeneration();
+    lru.Put("a", Value(1), 10, generation);
+    ASSERT(lru.Get("a"));
+    lru.Clear();
+    ASSERT(!lru.Get("a"));
+    lru.Put("b", Value(2), 10, generation);
+    ASSERT(!lru.Get("b"));
+    lru.Put("b", Value(2), 10, lru.GetGeneration());
+    ASSERT(lru.Get("b"));
+    const auto stats = lru.GetStats();
+    ASSERT_EQUAL(stats.hits, 2u);
+    ASSERT_EQUAL(stats.misses, 2u);
+    ASSERT_EQUAL(stats.entries, 1u);
+    ASSERT_EQUAL(stats.bytes, 10u);
+}
+
+// Бюджет делится между шардами и не превышается при одновременной записи
+void TestLruConcurrentBudget() {
+    Lru lru(16 * 100, 16);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&lru, t] {
+            for (int i = 0; i < 2000; ++i) {
+                const std::string key = std::to_string((i * 7 + t) % 500);
+                if (!lru.Get(key)) {
+                    lru.Put(key, Value(i), 10);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    const auto stats = lru.GetStats();
+    ASSERT_EQUAL(stats.hits + stats.misses, 8000u);
+    ASSERT(stats.bytes <= 16u * 100u);
+    ASSERT_EQUAL(stats.bytes, stats.entries * 10);
+}
+
+}  // namespace
+
+void TestCaches() {
+    RUN_TEST(TestLfuHitsAndMisses);
+    RUN_TEST(TestLfuEvictsRarest);
+    RUN_TEST(TestLfuRejectsOversized);
+    RUN_TEST(TestLfuAging);
+    RUN_TEST(TestLruEvictsLeastRecent);
+    RUN_TEST(TestLruReplaceAndReject);
+    RUN_TEST(TestLruClearAndGeneration);
+    RUN_TEST(TestLruConcurrentBudget);
+}
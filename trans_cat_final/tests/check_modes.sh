@@ -0,0 +1,57 @@
+#!/bin/bash
+# Проверяет, что режимы выполнения stat_requests дают байт в байт тот же
+# вывод, что и последовательное выполнение.
+# Запуск: check_modes.sh путь/к/trans_cat_final [вход.json...]
+# Без входных файлов документы генерируются gen_city.py
+set -euo pipefail
+
+if [ $# -lt 1 ]; then
+    echo "Usage: $0 path/to/trans_cat_final [input.json...]" >&2
+    exit 2
+fi
+binary=$1
+shift
+here=$(dirname "$0")
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+inputs=("$@")
+if [ ${#inputs[@]} -eq 0 ]; then
+    python3 "$here/gen_city.py" 1 60 25 400 > "$work/small.json"
+    python3 "$here/gen_city.py" 2 400 150 5000 2 > "$work/indented.json"
+    # Мало остановок — много одинаковых запросов и общих начальных остановок
+    python3 "$here/gen_city.py" 3 12 6 3000 > "$work/repeated.json"
+    # stat_requests раньше базы: конвейер откатывается к обычной загрузке
+    python3 -c 'import json, sys
+document = json.load(sys.stdin)
+requests = document.pop("stat_requests")
+print(json.dumps({"stat_requests": requests, **document}))' < "$work/small.json" > "$work/requests_first.json"
+    inputs=("$work/small.json" "$work/indented.json" "$work/repeated.json" "$work/requests_first.json")
+fi
+
+MODES=(
+    "--parallel --threads=1"
+    "--parallel --threads=2"
+    "--parallel --threads=8"
+    "--coalesce"
+    "--coalesce --parallel --threads=4"
+    "--pipeline --threads=1"
+    "--pipeline --threads=4"
+    "--pipeline --threads=4 --pipeline-depth=1"
+    "--pipeline-depth=100000"
+)
+
+failed=0
+for input in "${inputs[@]}"; do
+    "$binary" < "$input" > "$work/expected.json"
+    for mode in "${MODES[@]}"; do
+        # shellcheck disable=SC2086
+        if "$binary" $mode < "$input" > "$work/actual.json" && cmp -s "$work/expected.json" "$work/actual.json"; then
+            echo "OK   $(basename "$input") $mode"
+        else
+            echo "FAIL $(basename "$input") $mode"
+            failed=1
+        fi
+    done
+done
+exit $failed
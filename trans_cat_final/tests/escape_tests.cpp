@@ -0,0 +1,162 @@
+#include "test_framework.h"
+
+#include "../escape.h"
+#include "../json.h"
+
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+using namespace std::literals;
+
+namespace {
+
+// Эталон: посимвольная замена по той же таблице
+std::string EscapeJsonSlow(std::string_view text) {
+    std::string result;
+    for (const char c : text) {
+        switch (c) {
+        case '"':
+            result += "\\\""sv;
+            break;
+        case '\\':
+            result += "\\\\"sv;
+            break;
+        case '\n':
+            result += "\\n"sv;
+            break;
+        case '\r':
+            result += "\\r"sv;
+            break;
+        case '\t':
+            result += "\\t"sv;
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char code[8];
+                std::snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned>(c));
+                result += code;
+            } else {
+                result += c;
+            }
+        }
+    }
+    return result;
+}
+
+std::string EscapeXmlSlow(std::string_view text) {
+    std::string result;
+    for (const char c : text) {
+        switch (c) {
+        case '"':
+            result += "&quot;"sv;
+            break;
+        case '\'':
+            result += "&apos;"sv;
+            break;
+        case '<':
+            result += "&lt;"sv;
+            break;
+        case '>':
+            result += "&gt;"sv;
+            break;
+        case '&':
+            result += "&amp;"sv;
+            break;
+        default:
+            result += c;
+        }
+    }
+    return result;
+}
+
+// Длины вокруг границ блоков SSE2 (16) и AVX2 (32) байт
+constexpr size_t LENGTHS[] = {1, 15, 16, 17, 31, 32, 33, 47, 48, 63, 64, 65};
+
+// Любой байт в любой позиции строки: и в полном блоке, и в хвосте после него
+void TestEscapeEveryByteAtEveryPosition() {
+    for (const size_t length : LENGTHS) {
+        for (size_t position = 0; position < length; ++position) {
+            for (int byte = 0; byte < 256; ++byte) {
+                std::string text(length, 'a');
+                text[position] = static_cast<char>(byte);
+                ASSERT_EQUAL(escape::Json().Escaped(text), EscapeJsonSlow(text));
+                ASSERT_EQUAL(escape::Xml().Escaped(text), EscapeXmlSlow(text));
+            }
+        }
+    }
+}
+
+// Управляющий символ последним байтом блока и сразу за ним
+void TestEscapeControlAtBlockTail() {
+    for (const size_t length : LENGTHS) {
+        for (const char control : {'\x01', '\x1f', '\n', '\0'}) {
+            std::string text(length, 'x');
+            text.back() = control;
+            ASSERT_EQUAL(escape::Json().FindSpecial(text), length - 1);
+            ASSERT_EQUAL(escape::Json().Escaped(text), EscapeJsonSlow(text));
+            text += 'y';
+            ASSERT_EQUAL(escape::Json().FindSpecial(text), length - 1);
+        }
+    }
+}
+
+// Поиск с позиции, не кратной размеру блока, и строка без замен
+void TestFindSpecialFromPosition() {
+    std::string text(100, 'z');
+    text[5] = '"';
+    text[40] = '\\';
+    text[99] = '\x02';
+    ASSERT_EQUAL(escape::Json().FindSpecial(text, 0), 5u);
+    ASSERT_EQUAL(escape::Json().FindSpecial(text, 6), 40u);
+    ASSERT_EQUAL(escape::Json().FindSpecial(text, 41), 99u);
+    ASSERT_EQUAL(escape::Json().FindSpecial(std::string(70, 'q')), 70u);
+    // Байты от 0x80 — не управляющие, хотя char может быть знаковым
+    ASSERT_EQUAL(escape::Json().FindSpecial(std::string(70, '\xff')), 70u);
+    ASSERT_EQUAL(escape::Json().FindSpecial(""), 0u);
+}
+
+void TestWriteMatchesAppend() {
+    std::string text;
+    for (int i = 0; i < 300; ++i) {
+        text += static_cast<char>(i % 256);
+    }
+    std::ostringstream output;
+    escape::Json().Write(output, text);
+    ASSERT_EQUAL(output.str(), escape::Json().Escaped(text));
+}
+
+// Строка, экранированная для JSON, читается обратно без изменений
+void TestJsonEscapeRoundTrip() {
+    std::string text;
+    for (int byte = 1; byte < 256; ++byte) {
+        text += static_cast<char>(byte);
+    }
+    text += "\xF0\x9F\x9A\x8C"s;
+    std::istringstream input("\""s + escape::Json().Escaped(text) + "\""s);
+    ASSERT_EQUAL(json::Load(input).GetRoot().AsString(), text);
+    std::istringstream surrogate(R"("🚌 é")");
+    ASSERT_EQUAL(json::Load(surrogate).GetRoot().AsString(), "\xF0\x9F\x9A\x8C \xC3\xA9"s);
+    std::istringstream lone(R"("\ud83d")");
+    ASSERT_THROWS(json::Load(lone), json::ParsingError);
+}
+
+void TestEscaperLimits() {
+    ASSERT_THROWS(escape::Escaper({}), std::invalid_argument);
+    ASSERT_THROWS(escape::Escaper({{'a', "1"sv}, {'b', "2"sv}, {'c', "3"sv}, {'d', "4"sv}, {'e', "5"sv},
+                                   {'f', "6"sv}, {'g', "7"sv}, {'h', "8"sv}, {'i', "9"sv}}),
+                  std::invalid_argument);
+    const escape::Escaper escaper({{'%', "%%"sv}});
+    ASSERT_EQUAL(escaper.Escaped(std::string(40, 'a') + "%"s), std::string(40, 'a') + "%%"s);
+}
+
+}  // namespace
+
+void TestEscape() {
+    RUN_TEST(TestEscapeEveryByteAtEveryPosition);
+    RUN_TEST(TestEscapeControlAtBlockTail);
+    RUN_TEST(TestFindSpecialFromPosition);
+    RUN_TEST(TestWriteMatchesAppend);
+    RUN_TEST(TestJsonEscapeRoundTrip);
+    RUN_TEST(TestEscaperLimits);
+}
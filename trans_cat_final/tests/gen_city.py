@@ -0,0 +1,56 @@
+#!/usr/bin/env python3
+# Случайный, но воспроизводимый входной документ: остановки, автобусы
+# и смесь запросов Bus, Stop, Route и Map.
+# Запуск: gen_city.py SEED STOPS BUSES REQUESTS [INDENT] > input.json
+import json
+import random
+import sys
+
+seed, stop_count, bus_count, request_count = map(int, sys.argv[1:5])
+indent = int(sys.argv[5]) if len(sys.argv) > 5 else None
+random.seed(seed)
+
+# Каждая седьмая остановка — с символами, которые нужно экранировать
+stops = [f'Stop {i} & <Str"eet> \\ x' if i % 7 == 0 else f'S{i}' for i in range(stop_count)]
+base = []
+for name in stops:
+    distances = {random.choice(stops): random.randint(100, 5000) for _ in range(3)}
+    base.append({'type': 'Stop', 'name': name,
+                 'latitude': 55.5 + random.random() * 0.3,
+                 'longitude': 37.4 + random.random() * 0.4,
+                 'road_distances': distances})
+for i in range(bus_count):
+    route = random.sample(stops, random.randint(2, 8))
+    roundtrip = random.random() < 0.5
+    if roundtrip:
+        route.append(route[0])
+    base.append({'type': 'Bus', 'name': f'B{i}', 'stops': route, 'is_roundtrip': roundtrip})
+random.shuffle(base)
+
+requests = []
+for i in range(request_count):
+    kinds = ['Bus', 'Stop', 'Route', 'Route'] + (['Map'] if i % 50 == 0 else [])
+    kind = random.choice(kinds)
+    if kind == 'Bus':
+        # Среди названий бывают и несуществующие
+        requests.append({'id': i, 'type': 'Bus', 'name': f'B{random.randint(0, bus_count)}'})
+    elif kind == 'Stop':
+        requests.append({'id': i, 'type': 'Stop', 'name': random.choice(stops + ['nope'])})
+    elif kind == 'Route':
+        requests.append({'id': i, 'type': 'Route', 'from': random.choice(stops), 'to': random.choice(stops)})
+    else:
+        requests.append({'id': i, 'type': 'Map'})
+
+document = {
+    'base_requests': base,
+    'render_settings': {
+        'width': 1200.0, 'height': 1200.0, 'padding': 50.0, 'line_width': 14.0, 'stop_radius': 5.0,
+        'bus_label_font_size': 20, 'bus_label_offset': [7.0, 15.0],
+        'stop_label_font_size': 20, 'stop_label_offset': [7.0, -3.0],
+        'underlayer_color': [255, 255, 255, 0.85], 'underlayer_width': 3.0,
+        'color_palette': ['green', [255, 160, 0], 'red', [1, 2, 3, 0.5]],
+    },
+    'routing_settings': {'bus_wait_time': 6, 'bus_velocity': 40},
+    'stat_requests': requests,
+}
+print(json.dumps(document, indent=indent))
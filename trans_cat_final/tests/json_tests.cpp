@@ -0,0 +1,133 @@
+#include "test_framework.h"
+
+#include "../json.h"
+#include "../json_writer.h"
+
+#include <sstream>
+#include <string>
+
+using namespace std::literals;
+
+namespace {
+
+json::Dict LoadDict(const std::string& text) {
+    std::istringstream input(text);
+    return json::Load(input).GetRoot().AsMap();
+}
+
+// RawDict находит каждое поле и разбирает его так же, как json::Load
+void TestRawDictFields() {
+    const std::string text = R"( { "id" : 1 , "name":"a {b} [c], \"d\"",
+        "nested": {"x": [1, {"y": "}"}], "z": null},
+        "list":[ "]", 2.5e1 , true ], "empty": {} } )";
+    const json::RawDict raw(text);
+    const json::Dict parsed = LoadDict(text);
+    for (const auto& [key, value] : parsed) {
+        ASSERT(raw.at(key.Get()) == value);
+    }
+    ASSERT_EQUAL(raw.at("name").AsString(), "a {b} [c], \"d\""s);
+    ASSERT_EQUAL(raw.at("list").AsArray().size(), 3u);
+    ASSERT(!raw.Find("missing"));
+    ASSERT_THROWS(raw.at("missing"), std::out_of_range);
+    // Повторный поиск идёт по уже построенному оглавлению
+    ASSERT_EQUAL(raw.at("id").AsInt(), 1);
+}
+
+// Ключ с escape-последовательностями ищется по декодированному значению
+void TestRawDictEscapedKeys() {
+    const std::string text = R"({"a\"b": 1, "A": 2, "tab\t": 3})";
+    const json::RawDict raw(text);
+    ASSERT_EQUAL(raw.at("a\"b").AsInt(), 1);
+    ASSERT_EQUAL(raw.at("A").AsInt(), 2);
+    ASSERT_EQUAL(raw.at("tab\t").AsInt(), 3);
+    ASSERT(!raw.Find("a\\\"b"));
+}
+
+// При повторе ключа берётся первое значение, как и в json::Load
+void TestRawDictDuplicateKeys() {
+    const std::string text = R"({"type": "Bus", "name": "first", "name": "second"})";
+    const json::RawDict raw(text);
+    ASSERT_EQUAL(raw.at("name").AsString(), "first"s);
+    ASSERT_EQUAL(LoadDict(text).at("name").AsString(), raw.at("name").AsString());
+}
+
+void TestRawDictErrors() {
+    for (const std::string text : {R"({"a" 1})", R"({"a": 1 "b": 2})", R"([1, 2])", R"({"a": "x)"}) {
+        const json::RawDict raw(text);
+        ASSERT_THROWS(raw.Find("a"), json::ParsingError);
+    }
+}
+
+// Элементы ленивого массива — те же словари, что дал бы полный разбор
+void TestLazyDocument() {
+    const std::string text = R"({"base": [1], "stat_requests": [{"id": 1, "type": "Bus"}, {"id": 2}]})";
+    std::istringstream input(text);
+    const json::LazyDocument document(input, {"stat_requests"s});
+    const auto& requests = document.GetLazyArray("stat_requests");
+    ASSERT_EQUAL(requests.size(), 2u);
+    ASSERT_EQUAL(requests[0].at("type").AsString(), "Bus"s);
+    ASSERT_EQUAL(requests[1].at("id").AsInt(), 2);
+    ASSERT(!requests[1].Find("type"));
+    ASSERT_EQUAL(document.GetRoot().at("base").AsArray().size(), 1u);
+}
+
+// Каждое нарушение структуры документа — std::logic_error
+void TestWriterContextMisuse() {
+    std::string out;
+    {
+        json::Writer writer(out);
+        writer.StartDict();
+        ASSERT_THROWS(writer.Value(1), std::logic_error);
+        ASSERT_THROWS(writer.StartArray(), std::logic_error);
+        ASSERT_THROWS(writer.EndArray(), std::logic_error);
+        writer.Key("a");
+        ASSERT_THROWS(writer.Key("b"), std::logic_error);
+        ASSERT_THROWS(writer.EndDict(), std::logic_error);
+        writer.Value(1);
+        writer.EndDict();
+        ASSERT_THROWS(writer.Value(2), std::logic_error);
+        ASSERT_THROWS(writer.StartDict(), std::logic_error);
+        ASSERT_THROWS(writer.EndDict(), std::logic_error);
+        writer.Finish();
+    }
+    ASSERT_EQUAL(out, R"({"a":1})"s);
+    {
+        json::Writer writer(out);
+        ASSERT_THROWS(writer.Key("a"), std::logic_error);
+        ASSERT_THROWS(writer.Finish(), std::logic_error);
+        writer.StartArray();
+        ASSERT_THROWS(writer.Key("a"), std::logic_error);
+        ASSERT_THROWS(writer.EndDict(), std::logic_error);
+        ASSERT_THROWS(writer.Finish(), std::logic_error);
+    }
+}
+
+// Документ из Writer читается json::Load без потерь, в том числе
+// при сбросе буфера в поток после каждого значения
+void TestWriterRoundTrip() {
+    const std::string text = R"({"items": [1, -2.5, "a\"b", true, null, {"x": []}], "name": "\t"})";
+    const json::Node expected = LoadDict(text);
+    ASSERT_EQUAL(expected.AsMap().at("name").AsString(), "\t"s);
+    std::string out;
+    json::Writer(out).Value(expected).Finish();
+    ASSERT(LoadDict(out) == expected.AsMap());
+    std::ostringstream stream;
+    {
+        json::Writer writer(stream, json::DoubleFormat::STREAM, 1);
+        writer.StartDict().Key("items").RawValue(R"([1,2])").Key("map").Value(expected).EndDict();
+        writer.Finish();
+    }
+    ASSERT_EQUAL(stream.str(), R"({"items":[1,2],"map":)"s + out + "}"s);
+}
+
+}  // namespace
+
+void TestJson() {
+    RUN_TEST(TestRawDictFields);
+    RUN_TEST(TestRawDictEscapedKeys);
+    RUN_TEST(TestRawDictDuplicateKeys);
+    RUN_TEST(TestRawDictErrors);
+    RUN_TEST(TestLazyDocument);
+    RUN_TEST(TestWriterContextMisuse);
+    RUN_TEST(TestWriterRoundTrip);
+}
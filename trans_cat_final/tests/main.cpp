@@ -0,0 +1,19 @@
+#include "test_framework.h"
+
+#include <iostream>
+
+void TestCaches();
+void TestEscape();
+void TestJson();
+
+int main() {
+    TestCaches();
+    TestEscape();
+    TestJson();
+    if (test::FailedCount() > 0) {
+        std::cerr << test::FailedCount() << " test(s) failed" << std::endl;
+        return 1;
+    }
+    std::cerr << "All tests passed" << std::endl;
+    return 0;
+}
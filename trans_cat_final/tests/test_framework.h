@@ -0,0 +1,80 @@
+#pragma once
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+/*
+ * Минимальный набор проверок для модульных тестов: проваленная проверка
+ * прерывает только свой тест, RUN_TEST считает провалы и идёт дальше
+ */
+
+namespace test {
+
+class AssertionFailed : public std::runtime_error {
+public:
+    using runtime_error::runtime_error;
+};
+
+// Сколько тестов провалено за весь запуск
+inline int& FailedCount() {
+    static int count = 0;
+    return count;
+}
+
+inline std::string Location(const char* file, unsigned line) {
+    return std::string(file) + "(" + std::to_string(line) + "): ";
+}
+
+template <typename T, typename U>
+void AssertEqualImpl(const T& lhs, const U& rhs, const char* lhs_str, const char* rhs_str,
+                     const char* file, unsigned line) {
+    using namespace std::literals;
+    if (lhs == rhs) {
+        return;
+    }
+    std::ostringstream message;
+    message << Location(file, line) << "ASSERT_EQUAL("s << lhs_str << ", "s << rhs_str << ") failed: "s
+            << lhs << " != "s << rhs;
+    throw AssertionFailed(message.str());
+}
+
+inline void AssertImpl(bool value, const char* expr_str, const char* file, unsigned line) {
+    using namespace std::literals;
+    if (!value) {
+        throw AssertionFailed(Location(file, line) + "ASSERT("s + expr_str + ") failed"s);
+    }
+}
+
+template <typename Func>
+void RunTestImpl(Func func, const char* func_str) {
+    using namespace std::literals;
+    try {
+        func();
+        std::cerr << func_str << " OK"s << std::endl;
+    } catch (const AssertionFailed& e) {
+        ++FailedCount();
+        std::cerr << func_str << " fail: "s << e.what() << std::endl;
+    } catch (const std::exception& e) {
+        ++FailedCount();
+        std::cerr << func_str << " fail: unexpected exception: "s << e.what() << std::endl;
+    }
+}
+
+}  // namespace test
+
+#define ASSERT_EQUAL(a, b) test::AssertEqualImpl((a), (b), #a, #b, __FILE__, __LINE__)
+#define ASSERT(expr) test::AssertImpl(!!(expr), #expr, __FILE__, __LINE__)
+// Проверяет, что expr бросает исключение типа exception_type
+#define ASSERT_THROWS(expr, exception_type)                                         \
+    do {                                                                            \
+        bool thrown_ = false;                                                       \
+        try {                                                                       \
+            expr;                                                                   \
+        } catch (const exception_type&) {                                           \
+            thrown_ = true;                                                         \
+        }                                                                           \
+        test::AssertImpl(thrown_, #expr " throws " #exception_type, __FILE__, __LINE__); \
+    } while (false)
+#define RUN_TEST(func) test::RunTestImpl((func), #func)
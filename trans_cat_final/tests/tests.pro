@@ -0,0 +1,19 @@
+TEMPLATE = app
+CONFIG += console c++17
+CONFIG -= app_bundle
+CONFIG -= qt
+
+TARGET = trans_cat_tests
+INCLUDEPATH += ..
+
+SOURCES += \
+        ../escape.cpp \
+        ../json.cpp \
+        ../json_writer.cpp \
+        cache_tests.cpp \
+        escape_tests.cpp \
+        json_tests.cpp \
+        main.cpp
+
+HEADERS += \
+    test_framework.h
@@ -0,0 +1,153 @@
+#include "tile_pyramid.h"
+#include "parallel.h"
+#include "svgz.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+#include <tuple>
+
+namespace tiles {
+
+using namespace std::literals;
+using renderer::TileId;
+
+namespace {
+
+constexpr std::string_view ARCHIVE_MAGIC = "TCTILES1"sv;
+
+bool TileLess(TileId lhs, TileId rhs) {
+    return std::tie(lhs.z, lhs.x, lhs.y) < std::tie(rhs.z, rhs.x, rhs.y);
+}
+
+// Плитка в виде SVG или SVGZ; nullopt — на плитке ничего нет
+std::optional<std::string> DrawTile(const renderer::MapRenderer& renderer, const renderer::MapIndex& index,
+                                    TileId tile, const PyramidSettings& settings) {
+    std::string svg;
+    if (!renderer.RenderTile(index, tile, settings.tile_size, svg)) {
+        return std::nullopt;
+    }
+    if (!settings.svgz_level) {
+        return svg;
+    }
+    // Плитки небольшие: сжимаем уже готовую, пустые не сжимаются вовсе
+    std::string data;
+    svgz::GzipStream gzip(*settings.svgz_level, [&data](std::string_view chunk) {
+        data += chunk;
+    });
+    gzip << svg;
+    gzip.Finish();
+    return data;
+}
+
+}  // namespace
+
+DirectorySink::DirectorySink(std::string root, std::string extension)
+    : root_(std::move(root))
+    , extension_(std::move(extension)) {
+}
+
+void DirectorySink::Write(TileId tile, std::string_view data) {
+    const std::filesystem::path dir = std::filesystem::path(root_) / std::to_string(tile.z) / std::to_string(tile.x);
+    // Плитки одного столбца идут подряд: каталог создаётся при первой из них
+    if (dir != last_dir_) {
+        std::filesystem::create_directories(dir);
+        last_dir_ = dir;
+    }
+    const auto path = dir / (std::to_string(tile.y) + extension_);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(data.data(), static_cast<std::streamsize>(data.size()));
+    if (!file) {
+        throw std::runtime_error("Cannot write "s + path.string());
+    }
+}
+
+ArchiveSink::ArchiveSink(const std::string& path)
+    : path_(path)
+    , output_(path, std::ios::binary | std::ios::trunc) {
+    if (!output_) {
+        throw std::runtime_error("Cannot open "s + path);
+    }
+    WriteBytes(ARCHIVE_MAGIC);
+}
+
+void ArchiveSink::Write(TileId tile, std::string_view data) {
+    entries_.push_back({tile, offset_, data.size()});
+    WriteBytes(data);
+}
+
+void ArchiveSink::Finish() {
+    // Плитки приходят по уровням и внутри уровня по (x, y): оглавление уже упорядочено
+    const uint64_t index_offset = offset_;
+    for (const Entry& entry : entries_) {
+        WriteNumber(static_cast<uint32_t>(entry.tile.z), 4);
+        WriteNumber(entry.tile.x, 4);
+        WriteNumber(entry.tile.y, 4);
+        WriteNumber(entry.offset, 8);
+        WriteNumber(entry.size, 8);
+    }
+    WriteNumber(index_offset, 8);
+    WriteNumber(entries_.size(), 8);
+    WriteBytes(ARCHIVE_MAGIC);
+    output_.flush();
+    if (!output_) {
+        throw std::runtime_error("Cannot write "s + path_);
+    }
+}
+
+void ArchiveSink::WriteBytes(std::string_view data) {
+    output_.write(data.data(), static_cast<std::streamsize>(data.size()));
+    offset_ += data.size();
+}
+
+void ArchiveSink::WriteNumber(uint64_t value, size_t size) {
+    char bytes[8];
+    for (size_t i = 0; i < size; ++i) {
+        bytes[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+    WriteBytes({bytes, size});
+}
+
+PyramidStats RenderPyramid(const renderer::MapRenderer& renderer, const renderer::MapIndex& index,
+                           const PyramidSettings& settings, TileSink& sink) {
+    if (settings.max_zoom < 0 || settings.max_zoom > TileId::MAX_ZOOM) {
+        throw std::invalid_argument("Tile zoom must be in 0.."s + std::to_string(TileId::MAX_ZOOM));
+    }
+    const size_t thread_count = settings.thread_count > 0 ? settings.thread_count : parallel::DefaultThreadCount();
+    PyramidStats stats;
+    std::vector<TileId> level{TileId{}};
+    for (int z = 0; z <= settings.max_zoom && !level.empty(); ++z) {
+        std::vector<TileId> drawn;
+        // Готовые плитки ждут записи в окне OrderedForEach, а не копятся
+        // в памяти всем уровнем
+        parallel::OrderedForEach<std::optional<std::string>>(level.size(), thread_count, [&](size_t i) {
+            return DrawTile(renderer, index, level[i], settings);
+        }, [&](size_t i, std::optional<std::string> data) {
+            if (!data) {
+                return;
+            }
+            const TileId tile = level[i];
+            sink.Write(tile, *data);
+            ++stats.tile_count;
+            stats.bytes += data->size();
+            drawn.push_back(tile);
+        });
+        // Следующий уровень — только потомки непустых плиток
+        level.clear();
+        if (z == settings.max_zoom) {
+            break;
+        }
+        for (const TileId tile : drawn) {
+            for (uint32_t dx = 0; dx < 2; ++dx) {
+                for (uint32_t dy = 0; dy < 2; ++dy) {
+                    level.push_back({z + 1, 2 * tile.x + dx, 2 * tile.y + dy});
+                }
+            }
+        }
+        std::sort(level.begin(), level.end(), TileLess);
+    }
+    sink.Finish();
+    return stats;
+}
+
+}  // namespace tiles
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "map_renderer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Пакетная отрисовка пирамиды плиток: все непустые плитки уровней
+ * 0..max_zoom рисуются на всех ядрах и записываются в каталог либо
+ * в один файл с оглавлением
+ */
+
+namespace tiles {
+
+// Куда пишутся готовые плитки. Write вызывается из одного потока,
+// плитки приходят по уровням, внутри уровня — по возрастанию (x, y).
+// Ошибки записи — исключения std::runtime_error
+class TileSink {
+public:
+    virtual ~TileSink() = default;
+
+    virtual void Write(renderer::TileId tile, std::string_view data) = 0;
+    // Вызывается после последней плитки
+    virtual void Finish() {}
+};
+
+// Плитки в файлах root/z/x/y.svg (.svgz для сжатых)
+class DirectorySink : public TileSink {
+public:
+    DirectorySink(std::string root, std::string extension);
+
+    void Write(renderer::TileId tile, std::string_view data) override;
+
+private:
+    std::string root_;
+    std::string extension_;
+    std::filesystem::path last_dir_;
+};
+
+// Все плитки в одном файле: "TCTILES1", плитки подряд, затем оглавление —
+// по записи на плитку в порядке (z, x, y): z, x, y (uint32), смещение
+// и размер (uint64) — и в конце смещение оглавления, число плиток (uint64)
+// и снова "TCTILES1". Числа — little-endian. Читающий находит оглавление
+// по последним 24 байтам и ищет в нём плитку двоичным поиском
+class ArchiveSink : public TileSink {
+public:
+    explicit ArchiveSink(const std::string& path);
+
+    void Write(renderer::TileId tile, std::string_view data) override;
+    void Finish() override;
+
+private:
+    struct Entry {
+        renderer::TileId tile;
+        uint64_t offset = 0;
+        uint64_t size = 0;
+    };
+
+    void WriteBytes(std::string_view data);
+    void WriteNumber(uint64_t value, size_t size);
+
+    std::string path_;
+    std::ofstream output_;
+    uint64_t offset_ = 0;
+    std::vector<Entry> entries_;
+};
+
+struct PyramidSettings {
+    int max_zoom = 0;
+    // Сторона плитки на изображении
+    double tile_size = 256;
+    // 0 — по числу ядер
+    size_t thread_count = 0;
+    // Плитки сжимаются в SVGZ с этим уровнем zlib
+    std::optional<int> svgz_level;
+};
+
+struct PyramidStats {
+    size_t tile_count = 0;
+    uint64_t bytes = 0;
+};
+
+// Рисует пирамиду до уровня settings.max_zoom и пишет непустые плитки в sink.
+// Плитка, на которой ничего нет, не пишется, и её потомки не рассматриваются:
+// их области лежат внутри её области
+PyramidStats RenderPyramid(const renderer::MapRenderer& renderer, const renderer::MapIndex& index,
+                           const PyramidSettings& settings, TileSink& sink);
+
+}  // namespace tiles
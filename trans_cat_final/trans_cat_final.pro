@@ -3,30 +3,47 @@ CONFIG += console c++17
 CONFIG -= app_bundle
 CONFIG -= qt
 
+LIBS += -lz
+
 SOURCES += \
         domain.cpp \
+        escape.cpp \
         geo.cpp \
         json.cpp \
         json_builder.cpp \
         json_reader.cpp \
+        json_writer.cpp \
         main.cpp \
         map_renderer.cpp \
         request_handler.cpp \
+        server.cpp \
         svg.cpp \
+        svgz.cpp \
+        tile_pyramid.cpp \
         transport_catalogue.cpp \
         transport_router.cpp
 
 HEADERS += \
+    cache_stats.h \
     domain.h \
+    escape.h \
     geo.h \
     graph.h \
     json.h \
     json_builder.h \
     json_reader.h \
+    json_writer.h \
+    lfu_cache.h \
+    lru_cache.h \
     map_renderer.h \
+    parallel.h \
     ranges.h \
     request_handler.h \
     router.h \
+    server.h \
+    spatial_index.h \
     svg.h \
+    svgz.h \
+    tile_pyramid.h \
     transport_catalogue.h \
     transport_router.h
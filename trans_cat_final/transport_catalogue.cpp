@@ -9,40 +9,43 @@ namespace transport_catalogue
 void TransportCatalogue::AddStop(const Stop& stop) {
     stops_.push_back(stop);
     stopname_to_stop_[stops_.back().name] = &stops_.back();
+    ++version_;
+    ++stop_version_;
 }
 
 void TransportCatalogue::AddBus(const Bus& bus) {
-    buses_.push_back(bus);
-    busname_to_bus_[buses_.back().name] = &buses_.back();
-    for (const auto& stop_name : bus.route) {
-        stopname_to_buses_[stop_name].insert(bus.name);
+    const Bus& added = buses_.emplace_back(bus);
+    busname_to_bus_[added.name] = &added;
+    for (const auto& stop_name : added.route) {
+        stopname_to_buses_[stop_name].insert(added.name);
     }
+    ++version_;
 }
 
-const Stop* TransportCatalogue::FindStop(const std::string& name) const {
+const Stop* TransportCatalogue::FindStop(std::string_view name) const {
     auto it = stopname_to_stop_.find(name);
     return it != stopname_to_stop_.end() ? it->second : nullptr;
 }
 
-const Bus* TransportCatalogue::FindBus(const std::string& name) const {
+const Bus* TransportCatalogue::FindBus(std::string_view name) const {
     auto it = busname_to_bus_.find(name);
     return it != busname_to_bus_.end() ? it->second : nullptr;
 }
 
-const std::unordered_set<std::string>& TransportCatalogue::GetBusesByStop(const std::string& name) const {
-    static std::unordered_set<std::string> empty;
+const std::unordered_set<std::string_view>& TransportCatalogue::GetBusesByStop(std::string_view name) const {
+    static const std::unordered_set<std::string_view> empty;
     auto it = stopname_to_buses_.find(name);
     return it != stopname_to_buses_.end() ? it->second : empty;
 }
 
 
-BusRouteInfo TransportCatalogue::GetBusRoute(const std::string& name) const {
+BusRouteInfo TransportCatalogue::GetBusRoute(std::string_view name) const {
     const Bus* bus = FindBus(name);
     if (!bus || bus->route.empty()) {
         return {0, 0, 0, 0.0};
     }
 
-    std::unordered_set<std::string> unique_stops(bus->route.begin(), bus->route.end());
+    std::unordered_set<std::string_view> unique_stops(bus->route.begin(), bus->route.end());
     double geo_length = 0.0;
     int fact_length = 0;
 
@@ -72,10 +75,11 @@ BusRouteInfo TransportCatalogue::GetBusRoute(const std::string& name) const {
     return {bus->route.size(), unique_stops.size(), fact_length, curvature};
 }
 void TransportCatalogue::SetDistanceToStops(std::string_view from, std::string_view to, int distance) {
-    const Stop* from_stop = FindStop(std::string(from));
-    const Stop* to_stop = FindStop(std::string(to));
+    const Stop* from_stop = FindStop(from);
+    const Stop* to_stop = FindStop(to);
     if (from_stop && to_stop) {
         distance_to_stops[{from_stop, to_stop}] = distance;
+        ++version_;
     } else {
     }
 }
@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 #include <deque>
 #include <string>
 #include <string_view>
@@ -24,30 +25,46 @@ struct Hasher {
     std::hash<const void*> ptr_hasher;
 };
 
+// Имена хранятся один раз — в stops_ и buses_ (элементы deque не перемещаются),
+// индексы ссылаются на них через string_view.
+// Константные методы ничего не меняют, и после загрузки данных каталог можно
+// читать из нескольких потоков одновременно
 class TransportCatalogue {
 public:
     void AddStop(const Stop& stop);
     void AddBus(const Bus& bus);
-    const Stop* FindStop(const std::string& name) const;
-    const Bus* FindBus(const std::string& name) const;
-    BusRouteInfo GetBusRoute(const std::string& name) const;
-    const std::unordered_set<std::string>& GetBusesByStop(const std::string& name) const;
+    const Stop* FindStop(std::string_view name) const;
+    const Bus* FindBus(std::string_view name) const;
+    BusRouteInfo GetBusRoute(std::string_view name) const;
+    const std::unordered_set<std::string_view>& GetBusesByStop(std::string_view name) const;
     void SetDistanceToStops(std::string_view from, std::string_view to, int distance);
     int GetDistanceToStops(const Stop* stop1, const Stop* stop2) const;
-    const std::unordered_map<std::string,const Stop*>& GetAllStops() const {
+    const std::unordered_map<std::string_view,const Stop*>& GetAllStops() const {
         return stopname_to_stop_;
     }
 
-    const std::unordered_map<std::string,const Bus*>& GetAllBuses() const {
+    const std::unordered_map<std::string_view,const Bus*>& GetAllBuses() const {
         return busname_to_bus_;
     }
 
+    // Растёт при каждом изменении каталога; по нему сбрасываются кэши
+    uint64_t GetVersion() const {
+        return version_;
+    }
+    // Растёт при каждом добавлении остановки: названия в маршрутах могли
+    // начать указывать на другие остановки
+    uint64_t GetStopVersion() const {
+        return stop_version_;
+    }
+
 private:
     std::deque<Stop> stops_;
-    std::unordered_map<std::string, const Stop*> stopname_to_stop_;
+    std::unordered_map<std::string_view, const Stop*> stopname_to_stop_;
     std::deque<Bus> buses_;
-    std::unordered_map<std::string, const Bus*> busname_to_bus_;
-    std::unordered_map<std::string, std::unordered_set<std::string>> stopname_to_buses_;
+    std::unordered_map<std::string_view, const Bus*> busname_to_bus_;
+    std::unordered_map<std::string_view, std::unordered_set<std::string_view>> stopname_to_buses_;
     std::unordered_map<std::pair<const Stop*, const Stop*>, int, Hasher> distance_to_stops;
+    uint64_t version_ = 0;
+    uint64_t stop_version_ = 0;
 };
 }
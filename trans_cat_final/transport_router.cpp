@@ -6,24 +6,29 @@
 namespace transport {
 
 TransportRouter::TransportRouter(const transport_catalogue::TransportCatalogue& catalogue,
-                                 const RoutingSettings& settings)
-    : catalogue_(catalogue), settings_(settings) {
+                                 const RoutingSettings& settings,
+                                 RouterMode mode,
+                                 size_t tree_cache_bytes)
+    : catalogue_(catalogue), settings_(settings), mode_(mode) {
     BuildGraph();
+    if (mode_ == RouterMode::SINGLE_SOURCE && tree_cache_bytes > 0) {
+        tree_cache_ = std::make_unique<cache::LfuCache<graph::VertexId, Tree>>(tree_cache_bytes);
+    }
 }
 
 // Вспомогательный метод для добавления ребра автобусного маршрута
 void TransportRouter::AddBusEdge(std::string_view bus_name, std::string_view from_stop, std::string_view to_stop, double time, int span_count) {
-    size_t from_bus_vertex = stop_to_bus_vertex_.at(std::string(from_stop));
-    size_t to_wait_vertex = stop_to_wait_vertex_.at(std::string(to_stop));
+    size_t from_bus_vertex = stop_to_bus_vertex_.at(from_stop);
+    size_t to_wait_vertex = stop_to_wait_vertex_.at(to_stop);
 
     size_t edge_id = graph_.AddEdge({from_bus_vertex, to_wait_vertex, time});
-    edge_to_bus_info_[edge_id] = {std::string(bus_name), span_count};
+    edge_to_bus_info_[edge_id] = {bus_name, span_count};
 }
 
 // Вспомогательный метод для расчета времени сегмента маршрута
 double TransportRouter::CalculateSegmentTime(std::string_view from_stop, std::string_view to_stop, double speed_m_per_min) const {
-    const auto* from = catalogue_.FindStop(std::string(from_stop));
-    const auto* to = catalogue_.FindStop(std::string(to_stop));
+    const auto* from = catalogue_.FindStop(from_stop);
+    const auto* to = catalogue_.FindStop(to_stop);
 
     if (!from || !to) return 0;
 
@@ -106,37 +111,88 @@ void TransportRouter::BuildGraph() {
         }
     }
 
-    router_ = std::make_unique<graph::Router<double>>(graph_);
+    if (mode_ == RouterMode::ALL_PAIRS) {
+        router_ = std::make_unique<graph::Router<double>>(graph_);
+    }
 }
 
 std::optional<RouteInfo> TransportRouter::FindRoute(std::string_view from, std::string_view to) const {
-    if (stop_to_wait_vertex_.count(std::string(from)) == 0 || stop_to_wait_vertex_.count(std::string(to)) == 0) {
+    if (stop_to_wait_vertex_.count(from) == 0 || stop_to_wait_vertex_.count(to) == 0) {
         return std::nullopt;
     }
 
-    size_t from_vertex = stop_to_wait_vertex_.at(std::string(from));
-    size_t to_vertex = stop_to_wait_vertex_.at(std::string(to));
+    size_t from_vertex = stop_to_wait_vertex_.at(from);
+    size_t to_vertex = stop_to_wait_vertex_.at(to);
 
-    auto route = router_->BuildRoute(from_vertex, to_vertex);
+    auto route = router_ ? router_->BuildRoute(from_vertex, to_vertex)
+                         : GetTree(from_vertex)->BuildRoute(to_vertex);
     if (!route) {
         return std::nullopt;
     }
+    return MakeRouteInfo(*route);
+}
+
+std::vector<std::optional<RouteInfo>> TransportRouter::FindRoutes(std::string_view from,
+                                                                  const std::vector<std::string_view>& to) const {
+    std::vector<std::optional<RouteInfo>> result(to.size());
+    const auto from_it = stop_to_wait_vertex_.find(from);
+    if (from_it == stop_to_wait_vertex_.end()) {
+        return result;
+    }
+    std::shared_ptr<const Tree> tree;
+    if (!router_) {
+        tree = GetTree(from_it->second);
+    }
+    for (size_t i = 0; i < to.size(); ++i) {
+        const auto to_it = stop_to_wait_vertex_.find(to[i]);
+        if (to_it == stop_to_wait_vertex_.end()) {
+            continue;
+        }
+        auto route = tree ? tree->BuildRoute(to_it->second)
+                          : router_->BuildRoute(from_it->second, to_it->second);
+        if (route) {
+            result[i] = MakeRouteInfo(*route);
+        }
+    }
+    return result;
+}
+
+std::optional<cache::CacheStats> TransportRouter::GetTreeCacheStats() const {
+    if (!tree_cache_) {
+        return std::nullopt;
+    }
+    return tree_cache_->GetStats();
+}
+
+std::shared_ptr<const TransportRouter::Tree> TransportRouter::GetTree(graph::VertexId from) const {
+    if (!tree_cache_) {
+        return std::make_shared<const Tree>(graph_, from);
+    }
+    // Дерево из частой остановки берётся готовым: маршрут восстанавливается
+    // по предкам без поиска
+    if (auto tree = tree_cache_->Get(from)) {
+        return tree;
+    }
+    auto tree = std::make_shared<const Tree>(graph_, from);
+    tree_cache_->Offer(from, tree, tree->GetMemoryUsage());
+    return tree;
+}
 
+RouteInfo TransportRouter::MakeRouteInfo(const graph::Router<double>::RouteInfo& route) const {
     RouteInfo result;
-    result.total_time = route->weight;
+    result.total_time = route.weight;
 
     // Восстанавливаем маршрут из ребер
-    for (size_t edge_id : route->edges) {
+    for (size_t edge_id : route.edges) {
         const auto& edge = graph_.GetEdge(edge_id);
 
         if (edge_to_bus_info_.count(edge_id)) {
             // Это ребро автобуса
             const auto& [bus_name, span_count] = edge_to_bus_info_.at(edge_id);
-            result.items.push_back(BusItem{bus_name, span_count, edge.weight});
+            result.items.push_back(BusItem{std::string(bus_name), span_count, edge.weight});
         } else {
             // Это ребро ожидания
-            std::string stop_name = vertex_to_stop_.at(edge.from);
-            result.items.push_back(WaitItem{stop_name, edge.weight});
+            result.items.push_back(WaitItem{std::string(vertex_to_stop_.at(edge.from)), edge.weight});
         }
     }
 
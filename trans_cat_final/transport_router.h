@@ -3,6 +3,7 @@
 #include "transport_catalogue.h"
 #include "graph.h"
 #include "router.h"
+#include "lfu_cache.h"
 #include <optional>
 #include <string>
 #include <string_view>
@@ -18,6 +19,14 @@ struct RoutingSettings {
     double bus_velocity = 0;   // в км/ч
 };
 
+inline bool operator==(const RoutingSettings& lhs, const RoutingSettings& rhs) {
+    return lhs.bus_wait_time == rhs.bus_wait_time && lhs.bus_velocity == rhs.bus_velocity;
+}
+
+inline bool operator!=(const RoutingSettings& lhs, const RoutingSettings& rhs) {
+    return !(lhs == rhs);
+}
+
 // Структуры для элементов маршрута
 struct WaitItem {
     std::string stop_name;
@@ -35,14 +44,36 @@ struct RouteInfo {
     std::vector<std::variant<WaitItem, BusItem>> items;
 };
 
+enum class RouterMode {
+    ALL_PAIRS,      // все кратчайшие пути считаются при построении роутера
+    SINGLE_SOURCE,  // дерево кратчайших путей строится на каждый запрос
+};
+
 class TransportRouter {
 public:
+    // В режиме SINGLE_SOURCE деревья кратчайших путей из самых частых
+    // начальных остановок хранятся в кеше размером до tree_cache_bytes
     TransportRouter(const transport_catalogue::TransportCatalogue& catalogue,
-                    const RoutingSettings& settings);
+                    const RoutingSettings& settings,
+                    RouterMode mode = RouterMode::ALL_PAIRS,
+                    size_t tree_cache_bytes = 0);
 
+    // Только читает построенный граф: безопасно вызывать из нескольких потоков
     std::optional<RouteInfo> FindRoute(std::string_view from, std::string_view to) const;
+    // Маршруты из from в каждую из остановок to. В режиме SINGLE_SOURCE
+    // на все назначения строится одно дерево кратчайших путей
+    std::vector<std::optional<RouteInfo>> FindRoutes(std::string_view from,
+                                                     const std::vector<std::string_view>& to) const;
+
+    // Статистика кеша деревьев; nullopt, если кеша нет
+    std::optional<cache::CacheStats> GetTreeCacheStats() const;
 
 private:
+    using Tree = graph::ShortestPathTree<double>;
+
+    // Дерево из кеша либо построенное заново
+    std::shared_ptr<const Tree> GetTree(graph::VertexId from) const;
+    RouteInfo MakeRouteInfo(const graph::Router<double>::RouteInfo& route) const;
     void BuildGraph();
     void AddBusEdge(std::string_view bus_name,std::string_view from_stop,std::string_view to_stop, double time, int span_count);
     double CalculateSegmentTime(std::string_view from_stop, std::string_view to_stop, double speed_m_per_min) const;
@@ -50,16 +81,19 @@ private:
 
     const transport_catalogue::TransportCatalogue& catalogue_;
     RoutingSettings settings_;
+    RouterMode mode_;
 
     graph::DirectedWeightedGraph<double> graph_;
     std::unique_ptr<graph::Router<double>> router_;
+    std::unique_ptr<cache::LfuCache<graph::VertexId, Tree>> tree_cache_;
 
-    // Две вершины для каждой остановки: wait vertex и bus vertex
-    std::unordered_map<std::string, size_t> stop_to_wait_vertex_;
-    std::unordered_map<std::string, size_t> stop_to_bus_vertex_;
-    std::unordered_map<size_t, std::string> vertex_to_stop_;
+    // Две вершины для каждой остановки: wait vertex и bus vertex.
+    // Имена — ссылки на строки каталога, который переживает роутер
+    std::unordered_map<std::string_view, size_t> stop_to_wait_vertex_;
+    std::unordered_map<std::string_view, size_t> stop_to_bus_vertex_;
+    std::unordered_map<size_t, std::string_view> vertex_to_stop_;
 
-    std::unordered_map<size_t, std::pair<std::string, int>> edge_to_bus_info_;
+    std::unordered_map<size_t, std::pair<std::string_view, int>> edge_to_bus_info_;
 };
 
 } // namespace transport